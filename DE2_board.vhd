@@ -0,0 +1,43 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+-- Foreign subprograms through which DE2_top drives the board under GHDL,
+-- implemented in DE2_ghdl.c. The library path is only used by GHDL's mcode
+-- backend; the LLVM & GCC backends link DE2_ghdl.so at elaboration.
+package DE2_board is
+	subtype DE2_leds_t is std_logic_vector(17 downto 0);
+	subtype DE2_switches_t is std_logic_vector(17 downto 0);
+	subtype DE2_buttons_t is std_logic_vector(3 downto 0);
+
+	procedure DE2_leds(board : natural; t : time; leds : DE2_leds_t);
+	attribute foreign of DE2_leds : procedure is "VHPIDIRECT ./DE2_ghdl.so DE2_ghdl_leds";
+
+	procedure DE2_service(
+		board		: natural;
+		t		: time;
+		switches	: out DE2_switches_t;
+		buttons		: out DE2_buttons_t;
+		interval	: out time;
+		quit		: out boolean
+	);
+	attribute foreign of DE2_service : procedure is "VHPIDIRECT ./DE2_ghdl.so DE2_ghdl_service";
+end package DE2_board;
+
+package body DE2_board is
+	procedure DE2_leds(board : natural; t : time; leds : DE2_leds_t) is
+	begin
+		report "DE2_leds: VHPIDIRECT not linked" severity failure;
+	end procedure DE2_leds;
+
+	procedure DE2_service(
+		board		: natural;
+		t		: time;
+		switches	: out DE2_switches_t;
+		buttons		: out DE2_buttons_t;
+		interval	: out time;
+		quit		: out boolean
+	) is
+	begin
+		report "DE2_service: VHPIDIRECT not linked" severity failure;
+	end procedure DE2_service;
+end package body DE2_board;
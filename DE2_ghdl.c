@@ -0,0 +1,136 @@
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+
+// The GHDL backend: VHPIDIRECT foreign subprograms, declared in
+// DE2_board.vhd, through which DE2_top.vhd drives the board in board.c.
+//
+// GHDL passes time as a 64-bit count of femtoseconds (its default time
+// resolution), out scalars by reference, and constrained std_logic_vectors
+// as a pointer to their elements, leftmost first, each element being its
+// std_ulogic position.
+enum std_ulogic { SL_U, SL_X, SL_0, SL_1, SL_Z, SL_W, SL_L, SL_H, SL_DC };
+
+#define GHDL_TIME_PRECISION (-15)
+#define MAX_ARGS (64)
+
+static uint64_t ghdl_now;
+static int started;
+
+// Indexed by DE2_top's board generic, each created on first use.
+static struct board *boards[MAX_BOARDS];
+
+static uint64_t
+sim_now(void)
+{
+	return ghdl_now;
+}
+
+// Reads a width-bit (width-1 downto 0) vector. As with VPI, only a known 1
+// (or a weak 'H') counts; everything else reads as 0.
+static void
+slv_get(const uint8_t *slv, uint32_t *bits, int width)
+{
+	int i;
+
+	memset(bits, 0, VEC_WORDS(width) * sizeof(*bits));
+	for (i = 0; i < width; i++)
+		if (slv[width - 1 - i] == SL_1 || slv[width - 1 - i] == SL_H)
+			vec_set_bit(bits, i, 1);
+}
+
+static void
+slv_put(uint8_t *slv, const uint32_t *bits, int width)
+{
+	int i;
+
+	for (i = 0; i < width; i++)
+		slv[width - 1 - i] = vec_bit(bits, i) ? SL_1 : SL_0;
+}
+
+// GHDL's runtime has no plusargs of its own, so board_ghdl.sh hands them
+// over in the DE2_ARGS environment variable, separated by whitespace.
+static void
+args_from_env(void)
+{
+	static char *argv[MAX_ARGS];
+	char *args = getenv("DE2_ARGS"), *tok;
+	int argc = 0;
+
+	if (args != NULL) {
+		if ((args = strdup(args)) == NULL)
+			err(1, "strdup");
+		for (tok = strtok(args, " \t\n"); tok != NULL && argc < MAX_ARGS; tok = strtok(NULL, " \t\n"))
+			argv[argc++] = tok;
+	}
+	board_args(argc, argv);
+}
+
+static void
+ghdl_end(void)
+{
+	board_end();
+}
+
+// Every entry point carries the current time; the first one, whichever
+// process elaboration happens to run first, sets the board up. There is no
+// end-of-simulation hook, so the board is shut down from atexit.
+static void
+ghdl_enter(int64_t t)
+{
+	ghdl_now = t;
+	if (started)
+		return;
+
+	started = 1;
+	args_from_env();
+	board_init(sim_now, GHDL_TIME_PRECISION);
+	board_start();
+	atexit(ghdl_end);
+}
+
+static struct board *
+ghdl_board(int32_t id)
+{
+	if (id < 0 || id >= MAX_BOARDS)
+		errx(1, "DE2_top: board must be below %d, not %d", MAX_BOARDS, id);
+	if (boards[id] == NULL)
+		boards[id] = board_new();
+	return boards[id];
+}
+
+// Called from a process sensitive to the LEDs, i.e. on every change.
+void
+DE2_ghdl_leds(int32_t id, int64_t t, const uint8_t *leds)
+{
+	uint32_t on[VEC_WORDS(N_LED)];
+
+	ghdl_enter(t);
+	slv_get(leds, on, N_LED);
+	board_set_leds(ghdl_board(id), on);
+}
+
+// Called every +DE2_service_interval, or sooner when scripted input is due
+// before then, as returned in *interval. Applies queued input and hands the
+// LEDs to the GUI; *quit is set once the window closes.
+void
+DE2_ghdl_service(int32_t id, int64_t t, uint8_t *switches, uint8_t *buttons, int64_t *interval, uint8_t *quit)
+{
+	uint64_t next;
+	struct board *b;
+
+	ghdl_enter(t);
+	b = ghdl_board(id);
+	board_step(b);
+	slv_put(switches, board_switches(b), N_SW);
+	slv_put(buttons, board_buttons(b), N_BTN);
+
+	*interval = board_service_interval();
+	next = board_next_input(b);
+	if (next < (uint64_t)t + *interval)
+		*interval = next > (uint64_t)t ? next - t : 1;
+	*quit = board_quit_requested();
+}
@@ -0,0 +1,618 @@
+#include <err.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "vcd.h"
+
+// Replays a VCD of the board pins, as written by +DE2_vcd or by $dumpvars,
+// through the board core without simulating anything: every scope with
+// leds, switches or buttons in it gets a board of its own, animated by the
+// same LED integration and render path as a live run.
+//
+// The whole file is loaded and indexed up front: value changes go into one
+// array in time order, with the full pin state saved every REPLAY_KEY_EVERY
+// changes, so a seek is a binary search plus at most REPLAY_KEY_EVERY
+// changes replayed from the keyframe before it.
+//
+// Commands are read from stdin, one per line:
+//   pause, play           stop & resume (an empty line toggles)
+//   speed R               sim seconds per wall second, e.g. 1/1000
+//   seek T, seek +T, -T   jump to, or by, a time like 20us
+//   step [N]              pause, then jump over the next N change times
+//   where                 print the current time
+
+#define REPLAY_KEY_EVERY (1024)
+#define REPLAY_TICK_MS (5)
+#define REPLAY_SCOPE_MAX (256)
+
+// Words in any one pin value.
+#define PIN_WORDS VEC_WORDS(VCD_MAX_WIDTH)
+
+struct change {
+	uint64_t t;
+	uint32_t bits[PIN_WORDS];
+	uint16_t board;
+	uint16_t sig;
+};
+
+// A VCD identifier standing for one of a board's pins.
+struct var {
+	char id[16];
+	int board;
+	enum vcd_signal sig;
+};
+
+struct replay_board {
+	char scope[REPLAY_SCOPE_MAX];
+	struct board *board;
+	uint32_t pins[VCD_SIGNALS][PIN_WORDS]; // current state
+};
+
+static const struct {
+	const char *name;
+	int width;
+} pins[VCD_SIGNALS] = {
+	[VCD_LEDS] = { "leds", N_LED },
+	[VCD_SWITCHES] = { "switches", N_SW },
+	[VCD_BUTTONS] = { "buttons", N_BTN },
+};
+
+static struct replay_board boards[MAX_BOARDS];
+static int nboards;
+
+static struct var *vars;
+static int nvars;
+
+static struct change *changes;
+static size_t nchanges;
+static uint32_t *keys; // [nchanges / REPLAY_KEY_EVERY + 1][nboards][VCD_SIGNALS][PIN_WORDS]
+
+static int precision; // from $timescale
+static double unit;   // seconds per VCD time unit
+static uint64_t t_first, t_last;
+
+// Replay position. The board core's clock runs at pos + offset, and only
+// ever forward, so that a seek does not upset LED integration.
+static uint64_t pos;
+static uint64_t offset;
+static uint64_t board_clock;
+static size_t next_change;
+
+static uint64_t
+replay_now(void)
+{
+	return board_clock;
+}
+
+//////// VCD LOADING ////////
+
+static char *
+read_file(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	char *buf;
+	long n;
+
+	if (f == NULL)
+		err(1, "%s", path);
+	if (fseek(f, 0, SEEK_END) < 0 || (n = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) < 0)
+		err(1, "%s", path);
+	if ((buf = malloc(n + 1)) == NULL)
+		err(1, "malloc");
+	if (fread(buf, 1, n, f) != (size_t)n)
+		err(1, "%s", path);
+	buf[n] = '\0';
+	fclose(f);
+	return buf;
+}
+
+// Splits the text in place into whitespace-separated tokens.
+static char *
+next_token(char **p)
+{
+	char *s = *p, *tok;
+
+	while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+		s++;
+	if (*s == '\0')
+		return NULL;
+
+	tok = s;
+	while (*s != '\0' && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r')
+		s++;
+	if (*s != '\0')
+		*s++ = '\0';
+	*p = s;
+	return tok;
+}
+
+static void
+skip_to_end(char **p)
+{
+	char *tok;
+
+	while ((tok = next_token(p)) != NULL && strcmp(tok, "$end") != 0)
+		;
+}
+
+// "1ps", or "1 ps", to -12.
+static void
+parse_timescale(char **p)
+{
+	static const struct {
+		const char *suffix;
+		int exp;
+	} units[] = {
+		{"s", 0}, {"ms", -3}, {"us", -6}, {"ns", -9}, {"ps", -12}, {"fs", -15},
+	};
+	char ts[32] = "", *tok, *end;
+	long mag;
+	size_t i;
+
+	while ((tok = next_token(p)) != NULL && strcmp(tok, "$end") != 0)
+		strncat(ts, tok, sizeof(ts) - strlen(ts) - 1);
+
+	mag = strtol(ts, &end, 10);
+	for (i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+		if (strcmp(end, units[i].suffix) == 0 && (mag == 1 || mag == 10 || mag == 100)) {
+			precision = units[i].exp + (mag == 100 ? 2 : mag == 10 ? 1 : 0);
+			return;
+		}
+	}
+	errx(1, "VCD: bad $timescale %s", ts);
+}
+
+static int
+board_for_scope(const char *scope)
+{
+	int i;
+
+	for (i = 0; i < nboards; i++)
+		if (strcmp(boards[i].scope, scope) == 0)
+			return i;
+
+	if (nboards == MAX_BOARDS)
+		errx(1, "VCD: more than %d scopes with board pins in them", MAX_BOARDS);
+	snprintf(boards[nboards].scope, REPLAY_SCOPE_MAX, "%s", scope);
+	return nboards++;
+}
+
+// $var type width id name [range] $end
+static void
+parse_var(char **p, const char *scope, const char *only_scope)
+{
+	char *tok[4], *bracket;
+	int i, sig;
+
+	for (i = 0; i < 4; i++)
+		if ((tok[i] = next_token(p)) == NULL)
+			errx(1, "VCD: truncated $var");
+	skip_to_end(p);
+
+	if ((bracket = strchr(tok[3], '[')) != NULL)
+		*bracket = '\0';
+	for (sig = 0; sig < VCD_SIGNALS; sig++)
+		if (strcmp(tok[3], pins[sig].name) == 0)
+			break;
+	if (sig == VCD_SIGNALS || (only_scope != NULL && strcmp(scope, only_scope) != 0))
+		return;
+	if (atoi(tok[1]) > pins[sig].width)
+		errx(1, "VCD: %s.%s is %s bits wide, more than the board's %d",
+		    scope, tok[3], tok[1], pins[sig].width);
+
+	vars = realloc(vars, (nvars + 1) * sizeof(*vars));
+	if (vars == NULL)
+		err(1, "realloc");
+	snprintf(vars[nvars].id, sizeof(vars[nvars].id), "%s", tok[2]);
+	vars[nvars].board = board_for_scope(scope);
+	vars[nvars].sig = sig;
+	nvars++;
+}
+
+static void
+parse_header(char **p, const char *only_scope)
+{
+	char scope[REPLAY_SCOPE_MAX] = "";
+	char *tok;
+
+	precision = -9; // VCD's default of 1ns
+	while ((tok = next_token(p)) != NULL) {
+		if (strcmp(tok, "$enddefinitions") == 0) {
+			skip_to_end(p);
+			return;
+		} else if (strcmp(tok, "$scope") == 0) {
+			char *name;
+
+			next_token(p);
+			if ((name = next_token(p)) == NULL)
+				break;
+			if (*scope != '\0')
+				strncat(scope, ".", sizeof(scope) - strlen(scope) - 1);
+			strncat(scope, name, sizeof(scope) - strlen(scope) - 1);
+			skip_to_end(p);
+		} else if (strcmp(tok, "$upscope") == 0) {
+			char *dot = strrchr(scope, '.');
+
+			if (dot != NULL)
+				*dot = '\0';
+			else
+				*scope = '\0';
+			skip_to_end(p);
+		} else if (strcmp(tok, "$timescale") == 0) {
+			parse_timescale(p);
+		} else if (strcmp(tok, "$var") == 0) {
+			parse_var(p, scope, only_scope);
+		} else if (tok[0] == '$') {
+			skip_to_end(p);
+		}
+	}
+	errx(1, "VCD: no $enddefinitions");
+}
+
+static void
+add_change(uint64_t t, const char *id, const char *bits)
+{
+	static size_t cap;
+	int i;
+
+	size_t len = strlen(bits);
+
+	for (i = 0; i < nvars; i++) {
+		uint32_t v[PIN_WORDS] = {0};
+		size_t bit;
+
+		if (strcmp(vars[i].id, id) != 0)
+			continue;
+
+		// x & z read as 0, as the design would see them through VPI.
+		// Vars are no wider than their pins, so neither are values.
+		for (bit = 0; bit < len && bit < VCD_MAX_WIDTH; bit++)
+			vec_set_bit(v, bit, bits[len - 1 - bit] == '1');
+
+		if (nchanges == cap) {
+			cap = cap ? 2 * cap : 4096;
+			if ((changes = realloc(changes, cap * sizeof(*changes))) == NULL)
+				err(1, "realloc");
+		}
+		changes[nchanges].t = t;
+		memcpy(changes[nchanges].bits, v, sizeof(v));
+		changes[nchanges].board = vars[i].board;
+		changes[nchanges].sig = vars[i].sig;
+		nchanges++;
+	}
+}
+
+static void
+parse_body(char **p)
+{
+	uint64_t t = 0;
+	int timed = 0;
+	char *tok, *id;
+
+	while ((tok = next_token(p)) != NULL) {
+		switch (tok[0]) {
+		case '#':
+			t = strtoull(tok + 1, NULL, 10);
+			if (!timed)
+				t_first = t;
+			timed = 1;
+			if (t < t_last)
+				errx(1, "VCD: time goes backwards at #%llu", (unsigned long long)t);
+			t_last = t;
+			break;
+		case 'b':
+		case 'B':
+			if ((id = next_token(p)) == NULL)
+				errx(1, "VCD: truncated value change");
+			add_change(t, id, tok + 1);
+			break;
+		case 'r':
+		case 'R':
+			next_token(p);
+			break;
+		case '0':
+		case '1':
+		case 'x':
+		case 'X':
+		case 'z':
+		case 'Z': {
+			char bit[2] = { tok[0], '\0' };
+			add_change(t, tok + 1, bit);
+			break;
+		}
+		case '$':
+			// $dumpvars & co. only bracket value changes.
+			if (strcmp(tok, "$comment") == 0)
+				skip_to_end(p);
+			break;
+		}
+	}
+}
+
+static void
+build_keys(void)
+{
+	size_t i, nkeys = nchanges / REPLAY_KEY_EVERY + 1;
+	size_t key_len = (size_t)nboards * VCD_SIGNALS * PIN_WORDS;
+	uint32_t state[MAX_BOARDS][VCD_SIGNALS][PIN_WORDS] = {{{0}}};
+
+	keys = malloc(nkeys * key_len * sizeof(*keys));
+	if (keys == NULL)
+		err(1, "malloc");
+
+	for (i = 0; i < nchanges; i++) {
+		if (i % REPLAY_KEY_EVERY == 0)
+			memcpy(&keys[i / REPLAY_KEY_EVERY * key_len], state, key_len * sizeof(*keys));
+		memcpy(state[changes[i].board][changes[i].sig], changes[i].bits, sizeof(changes[i].bits));
+	}
+	if (nchanges % REPLAY_KEY_EVERY == 0)
+		memcpy(&keys[nchanges / REPLAY_KEY_EVERY * key_len], state, key_len * sizeof(*keys));
+}
+
+static void
+load(const char *path, const char *only_scope)
+{
+	char *text = read_file(path), *p = text;
+
+	parse_header(&p, only_scope);
+	if (nboards == 0)
+		errx(1, "%s: no leds, switches or buttons%s%s", path,
+		    only_scope ? " in " : "", only_scope ? only_scope : "");
+	parse_body(&p);
+	free(text);
+
+	build_keys();
+	unit = pow(10, precision);
+}
+
+//////// PLAYBACK ////////
+
+static void
+show(struct replay_board *rb, enum vcd_signal sig)
+{
+	if (sig == VCD_LEDS)
+		board_set_leds(rb->board, rb->pins[VCD_LEDS]);
+	else
+		board_show_inputs(rb->board, rb->pins[VCD_SWITCHES], rb->pins[VCD_BUTTONS]);
+}
+
+// Plays every change up to and including t, each at its own time, so LEDs
+// that changed several times between two frames show their duty cycle.
+static void
+advance(uint64_t t)
+{
+	for (; next_change < nchanges && changes[next_change].t <= t; next_change++) {
+		struct change *c = &changes[next_change];
+		struct replay_board *rb = &boards[c->board];
+
+		board_clock = c->t + offset;
+		memcpy(rb->pins[c->sig], c->bits, sizeof(c->bits));
+		show(rb, c->sig);
+	}
+	board_clock = t + offset;
+	pos = t;
+}
+
+// Jumps to t from the keyframe before it, all at the current board time.
+static void
+seek(uint64_t t)
+{
+	size_t lo = 0, hi = nchanges, i, k;
+	int b;
+
+	// The first change after t.
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (changes[mid].t <= t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	k = lo / REPLAY_KEY_EVERY;
+	for (b = 0; b < nboards; b++)
+		memcpy(boards[b].pins, &keys[(k * nboards + b) * VCD_SIGNALS * PIN_WORDS], sizeof(boards[b].pins));
+	for (i = k * REPLAY_KEY_EVERY; i < lo; i++)
+		memcpy(boards[changes[i].board].pins[changes[i].sig], changes[i].bits, sizeof(changes[i].bits));
+
+	for (b = 0; b < nboards; b++) {
+		show(&boards[b], VCD_LEDS);
+		show(&boards[b], VCD_SWITCHES);
+	}
+
+	next_change = lo;
+	offset = board_clock - t;
+	pos = t;
+}
+
+//////// CONTROL ////////
+
+static double speed;
+static int paused;
+static uint64_t anchor_pos;  // pos when last played, seeked or sped up
+static uint64_t anchor_wall; // ...at this wall time, in ns
+
+static uint64_t
+wall_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+reanchor(void)
+{
+	anchor_pos = pos;
+	anchor_wall = wall_ns();
+}
+
+static void
+report(void)
+{
+	printf("DE2: replay at %.9g s of %.9g s, %s at %g sim s per wall s\n",
+	    pos * unit, t_last * unit, paused ? "paused" : "playing", speed);
+	fflush(stdout);
+}
+
+static void
+command(char *line)
+{
+	char *cmd = strtok(line, " \t"), *arg = strtok(NULL, " \t");
+
+	if (cmd == NULL) {
+		paused = !paused;
+	} else if (strcmp(cmd, "pause") == 0) {
+		paused = 1;
+	} else if (strcmp(cmd, "play") == 0) {
+		paused = 0;
+	} else if (strcmp(cmd, "speed") == 0) {
+		double r = arg ? board_parse_ratio(arg) : 0;
+
+		if (r == 0) {
+			warnx("speed: need a positive ratio, e.g. 1/1000");
+			return;
+		}
+		speed = r;
+	} else if (strcmp(cmd, "seek") == 0 || cmd[0] == '+' || cmd[0] == '-') {
+		const char *s = strcmp(cmd, "seek") == 0 ? arg : cmd;
+		uint64_t t;
+		int rel = 0;
+
+		if (s != NULL && (*s == '+' || *s == '-'))
+			rel = *s++ == '+' ? 1 : -1;
+		if (s == NULL || ((t = board_parse_time(s)) == 0 && *s != '0')) {
+			warnx("seek: need a time, e.g. 20us, +1ms or -500ns");
+			return;
+		}
+		if (rel > 0)
+			t = pos + t;
+		else if (rel < 0)
+			t = t > pos ? 0 : pos - t;
+		seek(t < t_first ? t_first : t > t_last ? t_last : t);
+	} else if (strcmp(cmd, "step") == 0) {
+		long n = arg ? atol(arg) : 1;
+
+		paused = 1;
+		while (n-- > 0 && next_change < nchanges)
+			advance(changes[next_change].t);
+	} else if (strcmp(cmd, "where") != 0) {
+		warnx("commands: pause, play, speed R, seek [+-]T, step [N], where");
+		return;
+	}
+
+	reanchor();
+	report();
+}
+
+// Waits up to a tick for stdin, running whatever complete lines arrive.
+static void
+poll_commands(void)
+{
+	static char line[256];
+	static size_t len;
+	static int eof;
+	struct pollfd pfd = { 0, POLLIN, 0 };
+	char *nl;
+	ssize_t n;
+
+	if (eof) {
+		poll(NULL, 0, REPLAY_TICK_MS);
+		return;
+	}
+	if (poll(&pfd, 1, REPLAY_TICK_MS) <= 0)
+		return;
+
+	n = read(0, line + len, sizeof(line) - 1 - len);
+	if (n <= 0) {
+		eof = 1;
+		return;
+	}
+	len += n;
+	line[len] = '\0';
+
+	while ((nl = strchr(line, '\n')) != NULL) {
+		*nl = '\0';
+		command(line);
+		len -= nl + 1 - line;
+		memmove(line, nl + 1, len + 1);
+	}
+	if (len == sizeof(line) - 1)
+		len = 0; // too long to be a command
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *start, *rate;
+	int b;
+
+	if (argc < 2 || argv[1][0] == '+')
+		errx(1, "usage: DE2_replay board.vcd [+DE2_replay_scope=DE2.board0] [+DE2_replay_start=T] [+DE2_replay_speed=R] [+DE2_...]");
+
+	board_args(argc, argv);
+	load(argv[1], board_plusarg_str("DE2_replay_scope", NULL));
+
+	board_clock = t_first;
+	board_init(replay_now, precision);
+	for (b = 0; b < nboards; b++)
+		boards[b].board = board_new();
+	board_start();
+
+	// By default the whole run takes 10 wall seconds.
+	speed = t_last > t_first ? (t_last - t_first) * unit / 10 : 1;
+	if ((rate = board_plusarg_str("DE2_replay_speed", NULL)) != NULL &&
+	    (speed = board_parse_ratio(rate)) == 0)
+		errx(1, "+DE2_replay_speed must be a positive ratio, e.g. 1/1000");
+
+	seek(t_first);
+	if ((start = board_plusarg_str("DE2_replay_start", NULL)) != NULL) {
+		uint64_t t = board_parse_time(start);
+
+		seek(t < t_first ? t_first : t > t_last ? t_last : t);
+	}
+
+	for (b = 0; b < nboards; b++)
+		printf("DE2: board %d replays %s\n", b, boards[b].scope);
+	reanchor();
+	report();
+
+	while (!board_quit_requested()) {
+		poll_commands();
+
+		if (!paused) {
+			uint64_t t = anchor_pos + (uint64_t)((wall_ns() - anchor_wall) * 1e-9 * speed / unit);
+
+			advance(t < t_last ? t : t_last);
+			if (pos == t_last) {
+				paused = 1;
+				report();
+				// Nothing to look at, e.g. when only capturing frames.
+				if (board_headless())
+					break;
+			}
+		}
+
+		// Changes between two frames were integrated above; only the
+		// brightness they add up to is drawn. Clicks on the board are
+		// dropped: the recorded inputs stay in place.
+		for (b = 0; b < nboards; b++) {
+			if (board_input_pending(boards[b].board)) {
+				board_apply_input(boards[b].board);
+				show(&boards[b], VCD_SWITCHES);
+			}
+			board_render(boards[b].board);
+		}
+	}
+
+	board_end();
+	return 0;
+}
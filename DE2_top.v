@@ -0,0 +1,19 @@
+`timescale 1ns / 1ps
+
+// Board wrapper around the design under test; board.sh instantiates the
+// user's top module right after the marker comment at the end of the body.
+module DE2_top;
+	reg clk = 0;
+	wire [17:0] leds;
+	reg [17:0] switches;
+	reg [3:0] buttons;
+
+	// 50 MHz, like the board's CLOCK_50
+	always #10 clk = ~clk;
+
+	// The plugin services the board itself every +DE2_service_interval,
+	// keeping the clock free of VPI calls.
+	initial $DE2_attach(leds, switches, buttons, 1);
+
+	// TOPMODULE
+endmodule
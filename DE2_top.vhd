@@ -1,38 +1,53 @@
 library ieee;
 use ieee.std_logic_1164.all;
+use std.env.finish;
+use work.DE2_board.all;
 
+-- Board wrapper around the design under test, for GHDL; board_ghdl.sh
+-- instantiates the user's top entity right after the marker comment at the
+-- end of the architecture.
+-- Several instances, each with its own board number, get a board each.
 entity DE2_top is
-	port(
-		switches	: in	std_logic_vector(17 downto 0);
-		buttons		: in	std_logic_vector(3 downto 0);
-		leds		: out	std_logic_vector(17 downto 0)
+	generic(
+		board		: natural := 0
 	);
 end entity DE2_top;
 
 architecture main of DE2_top is
 
-	attribute foreign of main : architecture is “app_init app.sl”;
-	signal clk: std_logic;
+	signal clk		: std_logic := '0';
+	signal leds		: DE2_leds_t;
+	signal switches		: DE2_switches_t;
+	signal buttons		: DE2_buttons_t;
 
 begin
 
-	sw : process(switches, buttons)
+	-- 50 MHz, like the board's CLOCK_50
+	clk <= not clk after 10 ns;
+
+	-- The board follows every LED change, like $DE2_leds_watch.
+	watch : process(leds)
 	begin
-			$DE2_handle_input;
-			switches = $DE2_switches;
-			buttons = $DE2_buttons;
-			$DE2_leds(leds);
-			$DE2_render;
-	end process sw;
-
-	clkgen : process
+		DE2_leds(board, now, leds);
+	end process watch;
+
+	-- Like $DE2_attach: queued switch & button changes land, and the LEDs
+	-- are handed to the GUI, every +DE2_service_interval.
+	service : process
+		variable sw		: DE2_switches_t;
+		variable btn		: DE2_buttons_t;
+		variable interval	: time;
+		variable quit		: boolean;
 	begin
-
-		clk <= '0';
-		wait for clock_period/2;
-		clk <= '1';
-		wait for clock_period/2;
-
-	end process clkgen;
-
+		loop
+			DE2_service(board, now, sw, btn, interval, quit);
+			exit when quit;
+			switches <= sw;
+			buttons <= btn;
+			wait for interval;
+		end loop;
+		finish;
+	end process service;
+
+	-- TOPMODULE
 end architecture main;
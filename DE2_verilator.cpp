@@ -0,0 +1,80 @@
+#include <cmath>
+#include <cstdint>
+#include <verilated.h>
+
+#include "VDE2_vtop.h"
+#include "board.h"
+
+// The Verilator backend: the design is compiled into this executable and
+// the board is driven straight from the eval loop, LED, switch & button
+// states passing as plain words instead of through VPI.
+
+static VerilatedContext *ctx;
+
+static uint64_t
+sim_now(void)
+{
+	return ctx->time();
+}
+
+int
+main(int argc, char **argv)
+{
+	VDE2_vtop *top;
+	struct board *board;
+	uint64_t half_period, interval, next_service;
+	uint32_t leds;
+
+	ctx = new VerilatedContext;
+	ctx->commandArgs(argc, argv);
+	top = new VDE2_vtop(ctx);
+
+	board_args(argc, argv);
+	board_init(sim_now, ctx->timeprecision());
+	board = board_new();
+	board_start();
+
+	// 50 MHz, like the board's CLOCK_50
+	half_period = (uint64_t)(10e-9 / pow(10, ctx->timeprecision()) + 0.5);
+	interval = board_service_interval();
+	next_service = interval;
+
+	top->clk = 0;
+	top->switches = board_switches(board)[0];
+	top->buttons = board_buttons(board)[0];
+	top->eval();
+	leds = top->leds;
+	board_set_leds(board, &leds);
+
+	while (!ctx->gotFinish() && !board_quit_requested()) {
+		ctx->timeInc(half_period);
+		top->clk = !top->clk;
+		top->eval();
+
+		if (top->leds != leds) {
+			leds = top->leds;
+			board_set_leds(board, &leds);
+		}
+
+		// Input is applied between edges, so the design sees it on the
+		// next one, as with $DE2_attach's service boundaries; scripted
+		// input is applied at the first half period from its time on.
+		if (ctx->time() >= next_service || ctx->time() >= board_next_input(board)) {
+			int changed = board_step(board);
+
+			if (changed & INPUT_SWITCHES)
+				top->switches = board_switches(board)[0];
+			if (changed & INPUT_BUTTONS)
+				top->buttons = board_buttons(board)[0];
+			if (ctx->time() >= next_service)
+				next_service += interval;
+		}
+	}
+
+	top->final();
+	board_end();
+
+	delete top;
+	delete ctx;
+	return 0;
+}
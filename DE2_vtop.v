@@ -0,0 +1,13 @@
+`timescale 1ns / 1ps
+
+// Board wrapper for the Verilator flow. The clock and board I/O are ports,
+// driven from DE2_verilator.cpp's eval loop; `make verilator` instantiates
+// the user's top module right after the marker comment in the body.
+module DE2_vtop(
+	input clk,
+	output [17:0] leds,
+	input [17:0] switches,
+	input [3:0] buttons
+);
+	// TOPMODULE
+endmodule
@@ -0,0 +1,836 @@
+#include <err.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#include "board.h"
+#include "gui.h"
+#include "perf.h"
+#include "stimulus.h"
+#include "trace.h"
+#include "vcd.h"
+
+// Current simulation time, in units of 10^time_precision seconds.
+static uint64_t (*sim_now)(void);
+static int time_precision;
+static uint64_t sim_start; // at board_init
+
+//////// CONFIGURATION ////////
+
+// Maximum rate at which board_render hands LED states to the GUI, which is
+// also the rate at which the GUI thread redraws (+DE2_fps=N)
+static int render_fps = 60;
+
+// Maximum rate at which board_poll_input picks up GUI input (+DE2_poll_hz=N)
+static int poll_hz = 1000;
+
+// Run without a window or SDL video (+DE2_headless or DE2_HEADLESS=1)
+static int headless;
+
+// Capture frames to this PNG sequence or .y4m file (+DE2_capture=path),
+// keeping every Nth GUI frame (+DE2_capture_every=N) and queueing at most
+// +DE2_capture_queue=N frames for the encoder before dropping.
+static const char *capture_path;
+static int capture_every = 1;
+static int capture_depth = 8;
+
+// Drive the switches & buttons from this script (+DE2_stimulus=path)
+static const char *stimulus_path;
+
+// Log every input change made in the window (+DE2_record_input=path), or
+// apply such a log, ignoring the window (+DE2_replay_input=path).
+static const char *record_path;
+static const char *replay_path;
+
+// Record the board pins to this VCD (+DE2_vcd=path)
+static const char *vcd_path;
+
+// Write a Chrome trace-event timeline of every perf span (+DE2_trace=path)
+static const char *trace_path;
+
+// Sim time between board services, in simulation time units
+// (+DE2_service_interval=T, where T may carry a s/ms/us/ns/ps/fs suffix)
+static const char *service_interval_arg;
+static uint64_t service_interval;
+
+// Simulated seconds per wall-clock second (+DE2_pace=R), 0 for flat out
+static double pace_ratio;
+
+static int board_argc;
+static char **board_argv;
+
+void
+board_args(int argc, char **argv)
+{
+	board_argc = argc;
+	board_argv = argv;
+}
+
+// Returns what follows "+<name>" in the matching plusarg, i.e. "" for a bare
+// flag or "=<value>", or NULL if it is not given.
+static const char *
+plusarg(const char *name)
+{
+	size_t len = strlen(name);
+	int i;
+
+	for (i = 0; i < board_argc; i++) {
+		const char *arg = board_argv[i];
+		if (arg[0] == '+' && strncmp(arg + 1, name, len) == 0 &&
+		    (arg[len + 1] == '\0' || arg[len + 1] == '='))
+			return arg + len + 1;
+	}
+	return NULL;
+}
+
+const char *
+board_plusarg_str(const char *name, const char *def)
+{
+	const char *v = plusarg(name);
+
+	if (v == NULL || *v != '=')
+		return def;
+	return v + 1;
+}
+
+// Returns the integer value of +<name>=<value>, or def if it is not given.
+static int
+plusarg_int(const char *name, int def)
+{
+	const char *v = plusarg(name);
+
+	if (v == NULL || *v != '=')
+		return def;
+	return atoi(v + 1);
+}
+
+// Parses a time like "100us" into simulation time units; a bare number is
+// taken to already be in those units. Returns 0 if s is malformed.
+uint64_t
+board_parse_time(const char *s)
+{
+	static const struct {
+		const char *suffix;
+		int exp;
+	} units[] = {
+		{"s", 0}, {"ms", -3}, {"us", -6}, {"ns", -9}, {"ps", -12}, {"fs", -15},
+	};
+	char *end;
+	double v = strtod(s, &end);
+	size_t i;
+
+	if (end == s || v < 0)
+		return 0;
+	if (*end == '\0')
+		return (uint64_t)v;
+
+	for (i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+		if (strcmp(end, units[i].suffix) == 0)
+			return (uint64_t)(v * pow(10, units[i].exp - time_precision) + 0.5);
+	}
+	return 0;
+}
+
+double
+board_parse_ratio(const char *s)
+{
+	char *end;
+	double num = strtod(s, &end), den = 1;
+
+	if (end != s && *end == '/')
+		den = strtod(end + 1, &end);
+	if (end == s || *end != '\0' || !(num > 0) || !(den > 0))
+		return 0;
+	return num / den;
+}
+
+static int
+env_flag(const char *name)
+{
+	const char *v = getenv(name);
+	return v != NULL && *v != '\0' && strcmp(v, "0") != 0;
+}
+
+static void
+config_load(void)
+{
+	const char *pace;
+
+	render_fps = plusarg_int("DE2_fps", render_fps);
+	poll_hz = plusarg_int("DE2_poll_hz", poll_hz);
+	headless = plusarg("DE2_headless") != NULL || env_flag("DE2_HEADLESS");
+	capture_path = board_plusarg_str("DE2_capture", NULL);
+	capture_every = plusarg_int("DE2_capture_every", capture_every);
+	capture_depth = plusarg_int("DE2_capture_queue", capture_depth);
+	stimulus_path = board_plusarg_str("DE2_stimulus", NULL);
+	record_path = board_plusarg_str("DE2_record_input", NULL);
+	replay_path = board_plusarg_str("DE2_replay_input", NULL);
+	vcd_path = board_plusarg_str("DE2_vcd", NULL);
+	trace_path = board_plusarg_str("DE2_trace", NULL);
+	service_interval_arg = board_plusarg_str("DE2_service_interval", "100us");
+	pace = board_plusarg_str("DE2_pace", NULL);
+
+	if (render_fps <= 0)
+		errx(1, "+DE2_fps must be positive");
+	if (poll_hz < 0)
+		errx(1, "+DE2_poll_hz must not be negative");
+	if (capture_every <= 0 || capture_depth <= 0)
+		errx(1, "+DE2_capture_every and +DE2_capture_queue must be positive");
+	if (pace != NULL && (pace_ratio = board_parse_ratio(pace)) == 0)
+		errx(1, "+DE2_pace must be a positive ratio, e.g. 1 or 1/1000");
+}
+
+//////// RATE LIMITING ////////
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct rate_limit {
+	uint64_t period_ns; // 0 means unlimited
+	uint64_t next_ns;
+};
+
+static void
+rate_limit_init(struct rate_limit *rl, int hz)
+{
+	rl->period_ns = hz > 0 ? 1000000000 / hz : 0;
+	rl->next_ns = 0;
+}
+
+// Returns nonzero if the caller may do its work now, i.e. at least one
+// period has passed since the last time it was allowed to.
+static int
+rate_limit_pass(struct rate_limit *rl)
+{
+	uint64_t now;
+
+	if (rl->period_ns == 0)
+		return 1;
+
+	now = now_ns();
+	if (now < rl->next_ns)
+		return 0;
+
+	rl->next_ns = now + rl->period_ns;
+	return 1;
+}
+
+//////// SIM<->GUI EXCHANGE ////////
+
+// A double-buffered board_snapshot with a single writer. The writer fills
+// the back buffer without holding the lock and only takes it to flip; the
+// reader takes it to copy the front buffer out, so neither side ever waits
+// on the other's rendering or simulation work.
+struct exchange {
+	SDL_mutex *lock;
+	struct board_snapshot buf[2];
+	int front;
+	SDL_atomic_t seq; // bumped on every publish
+};
+
+static void
+exchange_init(struct exchange *x)
+{
+	x->lock = SDL_CreateMutex();
+	if (x->lock == NULL)
+		err(1, "SDL_CreateMutex: %s", SDL_GetError());
+}
+
+static void
+exchange_publish(struct exchange *x, const struct board_snapshot *snap)
+{
+	x->buf[!x->front] = *snap;
+
+	SDL_LockMutex(x->lock);
+	x->front = !x->front;
+	SDL_UnlockMutex(x->lock);
+
+	SDL_AtomicAdd(&x->seq, 1);
+}
+
+// Copies out the latest published snapshot, if any was published since
+// *seen; the common nothing-new case costs one atomic load.
+static int
+exchange_fetch(struct exchange *x, struct board_snapshot *snap, int *seen)
+{
+	int seq = SDL_AtomicGet(&x->seq);
+	if (seq == *seen)
+		return 0;
+
+	SDL_LockMutex(x->lock);
+	*snap = x->buf[x->front];
+	SDL_UnlockMutex(x->lock);
+
+	*seen = seq;
+	return 1;
+}
+
+// An entry in a board's input queue, see INPUT QUEUE.
+struct input_event {
+	enum input_kind kind;
+	int index; // vecidx
+	int state;
+};
+
+#define INPUT_QUEUE_LEN (256)
+
+//////// BOARD STATE ////////
+
+// Everything about one board the simulator side touches; the GUI thread
+// keeps its own view of each board in gui.c. Boards may be added at any
+// time, even once the GUI is running: the list only ever grows, and a
+// board is fully set up before it is counted.
+struct board {
+	int index;
+
+	// Switch & button states as the design sees them.
+	struct board_inputs inputs;
+	unsigned input_gen; // bumped whenever inputs change
+	struct input_event input_queue[INPUT_QUEUE_LEN];
+	SDL_atomic_t input_head; // next to apply, advanced by the simulator
+	SDL_atomic_t input_tail; // next to fill, advanced by the GUI
+
+	// LED on-times, see LED INTEGRATION.
+	uint32_t leds_on[VEC_WORDS(N_LED)];
+	uint64_t leds_on_since[N_LED];
+	uint64_t leds_on_time[N_LED];
+	uint64_t leds_frame_start;
+
+	struct board_snapshot state; // LED brightnesses being handed off
+	struct exchange to_gui;      // ...written by the simulator
+
+	struct rate_limit render_limit;
+	struct rate_limit poll_limit;
+};
+
+static struct board *boards[MAX_BOARDS];
+static SDL_atomic_t nboards;
+
+static int initialized; // board_init has run
+static int gui_running; // LED states are only handed off when set
+
+static void
+board_limits_init(struct board *b)
+{
+	rate_limit_init(&b->render_limit, render_fps);
+	rate_limit_init(&b->poll_limit, poll_hz);
+}
+
+struct board *
+board_new(void)
+{
+	struct board *b;
+	int n = SDL_AtomicGet(&nboards);
+
+	if (n == MAX_BOARDS)
+		errx(1, "DE2: at most %d boards are supported", MAX_BOARDS);
+
+	b = calloc(1, sizeof(*b));
+	if (b == NULL)
+		err(1, "calloc");
+
+	b->index = n;
+	exchange_init(&b->to_gui);
+	if (initialized)
+		board_limits_init(b);
+
+	// The simulator must see the initial switch & button positions even
+	// before the GUI thread publishes anything.
+	gui_pack_inputs(&b->inputs);
+	if (initialized && vcd_path != NULL)
+		vcd_board(n, b->inputs.switches, b->inputs.buttons);
+
+	boards[n] = b;
+	SDL_AtomicSet(&nboards, n + 1);
+	return b;
+}
+
+int
+board_count(void)
+{
+	return SDL_AtomicGet(&nboards);
+}
+
+struct board *
+board_get(int i)
+{
+	return boards[i];
+}
+
+int
+board_index(const struct board *b)
+{
+	return b->index;
+}
+
+int
+board_fetch_leds(struct board *b, struct board_snapshot *snap, int *seen)
+{
+	return exchange_fetch(&b->to_gui, snap, seen);
+}
+
+//////// LED INTEGRATION ////////
+
+// Each LED's on-time is integrated over simulation time between hand-offs
+// to the GUI, and drawn as its duty cycle, so PWM-dimmed or multiplexed LEDs
+// look right at any render rate. Only transitions are timestamped; setting
+// the LEDs to what they already are does no integration work at all.
+// Indexed by vector bit, i.e. red_leds[i].vecidx.
+void
+board_set_leds(struct board *b, const uint32_t *on)
+{
+	uint64_t now = 0;
+	int w, any = 0;
+
+	for (w = 0; w < VEC_WORDS(N_LED); w++) {
+		uint32_t changed = on[w] ^ b->leds_on[w];
+
+		if (changed == 0)
+			continue;
+		if (!any)
+			now = sim_now();
+		any = 1;
+
+		while (changed) {
+			int bit = w * 32 + __builtin_ctz(changed);
+			changed &= changed - 1;
+
+			if (vec_bit(on, bit))
+				b->leds_on_since[bit] = now;
+			else
+				b->leds_on_time[bit] += now - b->leds_on_since[bit];
+		}
+		b->leds_on[w] = on[w];
+	}
+
+	if (any && vcd_path != NULL)
+		vcd_change(b->index, VCD_LEDS, now, on);
+}
+
+// Fills b->state.leds with each LED's brightness since the last call.
+static void
+leds_integrate(struct board *b)
+{
+	uint64_t now = sim_now();
+	uint64_t span = now - b->leds_frame_start;
+	size_t i;
+
+	for (i = 0; i < N_LED; i++) {
+		int bit = red_leds[i].vecidx;
+		int on = vec_bit(b->leds_on, bit);
+		uint64_t t = b->leds_on_time[bit];
+
+		if (on) {
+			t += now - b->leds_on_since[bit];
+			b->leds_on_since[bit] = now;
+		}
+		b->leds_on_time[bit] = 0;
+
+		// With no sim time elapsed there is nothing to average over.
+		b->state.leds[i] = span ? (int)(t * LED_FULL / span) : on * LED_FULL;
+	}
+
+	b->leds_frame_start = now;
+}
+
+//////// INPUT QUEUE ////////
+
+// Switch & button changes travel from the GUI to the simulator in order,
+// through a single-producer, single-consumer ring per board, so a key tap
+// shorter than the simulator's polling period still reaches the design.
+
+// Returns zero, leaving the queue untouched, if it is full.
+int
+board_push_input(struct board *b, enum input_kind kind, int index, int state)
+{
+	int tail = SDL_AtomicGet(&b->input_tail);
+	int next = (tail + 1) % INPUT_QUEUE_LEN;
+
+	if (next == SDL_AtomicGet(&b->input_head))
+		return 0;
+	// SDL_AtomicGet & Set order nothing around them, so the barriers pair
+	// the entry's writes here with its reads in board_apply_input, and the
+	// simulator's last reads of the slot with its reuse here.
+	SDL_MemoryBarrierAcquire();
+
+	b->input_queue[tail].kind = kind;
+	b->input_queue[tail].index = index;
+	b->input_queue[tail].state = state;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&b->input_tail, next);
+	return 1;
+}
+
+// Scripted input (+DE2_stimulus) takes the same path as the GUI's, only
+// from the simulator thread: it is due once sim time reaches it.
+uint64_t
+board_next_input(struct board *b)
+{
+	const struct stimulus_event *ev = stimulus_peek(b->index);
+
+	return ev != NULL ? ev->t : UINT64_MAX;
+}
+
+static int
+stimulus_due(struct board *b)
+{
+	uint64_t t = board_next_input(b);
+
+	return t != UINT64_MAX && t <= sim_now();
+}
+
+int
+board_input_pending(struct board *b)
+{
+	return SDL_AtomicGet(&b->input_head) != SDL_AtomicGet(&b->input_tail) ||
+	    stimulus_due(b);
+}
+
+// Sets one input, unless it was already changed in this batch.
+static int
+input_set(struct board *b, uint32_t touched[][VEC_WORDS(SDL_max(N_SW, N_BTN))],
+    enum input_kind kind, int index, int state)
+{
+	if (vec_bit(touched[kind], index))
+		return 0;
+	vec_set_bit(touched[kind], index, 1);
+
+	if (kind == INPUT_SWITCH)
+		vec_set_bit(b->inputs.switches, index, state);
+	else
+		vec_set_bit(b->inputs.buttons, index, state);
+	return 1;
+}
+
+// Applies due scripted changes, then queued ones, to b->inputs, stopping
+// short of any change to an input already changed in this batch, so that
+// every press and release is seen by the design for at least one batch.
+int
+board_apply_input(struct board *b)
+{
+	uint32_t touched[2][VEC_WORDS(SDL_max(N_SW, N_BTN))] = {{0}};
+	const struct stimulus_event *se;
+	int head = SDL_AtomicGet(&b->input_head);
+	int tail = SDL_AtomicGet(&b->input_tail);
+	int changed = 0;
+	uint64_t now = 0;
+
+	SDL_MemoryBarrierAcquire(); // see board_push_input
+
+	if ((se = stimulus_peek(b->index)) != NULL) {
+		now = sim_now();
+		for (; se != NULL && se->t <= now; se = stimulus_peek(b->index)) {
+			if (!input_set(b, touched, se->kind, se->index, se->state))
+				break;
+			changed |= 1 << se->kind;
+			stimulus_take(b->index);
+		}
+		// The window shows what the script did to the board.
+		b->state.show_inputs = 1;
+	}
+
+	// A replayed session is all the input there is; clicks are dropped.
+	if (replay_path != NULL)
+		head = tail;
+
+	for (; head != tail; head = (head + 1) % INPUT_QUEUE_LEN) {
+		struct input_event *ev = &b->input_queue[head];
+
+		if (!input_set(b, touched, ev->kind, ev->index, ev->state))
+			break;
+		changed |= 1 << ev->kind;
+
+		if (record_path != NULL) {
+			if (now == 0)
+				now = sim_now();
+			stimulus_record(now, b->index, ev->kind, ev->index, ev->state);
+		}
+	}
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&b->input_head, head);
+	if (changed)
+		b->input_gen++;
+
+	if (changed && vcd_path != NULL) {
+		if (now == 0)
+			now = sim_now();
+
+		if (changed & INPUT_SWITCHES)
+			vcd_change(b->index, VCD_SWITCHES, now, b->inputs.switches);
+		if (changed & INPUT_BUTTONS)
+			vcd_change(b->index, VCD_BUTTONS, now, b->inputs.buttons);
+	}
+	return changed;
+}
+
+unsigned
+board_input_gen(struct board *b)
+{
+	return b->input_gen;
+}
+
+int
+board_poll_input(struct board *b)
+{
+	// A script runs to the sim time, whatever the rate or the window.
+	if (stimulus_due(b))
+		return board_apply_input(b);
+	if (headless || !rate_limit_pass(&b->poll_limit))
+		return 0;
+	return board_input_pending(b) ? board_apply_input(b) : 0;
+}
+
+const uint32_t *
+board_switches(struct board *b)
+{
+	return b->inputs.switches;
+}
+
+const uint32_t *
+board_buttons(struct board *b)
+{
+	return b->inputs.buttons;
+}
+
+void
+board_show_inputs(struct board *b, const uint32_t *switches, const uint32_t *buttons)
+{
+	memcpy(b->inputs.switches, switches, sizeof(b->inputs.switches));
+	memcpy(b->inputs.buttons, buttons, sizeof(b->inputs.buttons));
+	b->input_gen++;
+
+	b->state.show_inputs = 1;
+}
+
+//////// REAL-TIME PACING ////////
+
+// +DE2_pace=R maps simulation time to wall-clock time at R simulated
+// seconds per wall second ("1" for real time, "1/1000" to watch a 50 MHz
+// design at 50 kHz). The backend calls board_pace every board_pace_step of
+// sim time, i.e. every PACE_QUANTUM_NS of wall time at pace; it sleeps if
+// the simulation is ahead of schedule, and if it is behind, the achieved
+// rate is reported once a wall second.
+#define PACE_QUANTUM_NS (1000000)
+
+static double pace_tick_ns;    // wall ns per sim time unit, at pace
+static uint64_t pace_step;     // sim time units per quantum
+static uint64_t pace_sim0;     // schedule origin
+static uint64_t pace_wall0;
+static uint64_t pace_report_sim; // last report
+static uint64_t pace_report_wall;
+static uint64_t pace_next;       // due for board_step
+
+static void
+pace_rebase(uint64_t sim, uint64_t wall)
+{
+	pace_sim0 = sim;
+	pace_wall0 = wall;
+}
+
+static void
+pace_init(void)
+{
+	double unit = pow(10, time_precision); // seconds per sim time unit
+
+	pace_tick_ns = unit / pace_ratio * 1e9;
+	pace_step = (uint64_t)(PACE_QUANTUM_NS / pace_tick_ns);
+	if (pace_step == 0)
+		pace_step = 1;
+
+	pace_rebase(sim_now(), now_ns());
+	pace_report_sim = pace_sim0;
+	pace_report_wall = pace_wall0;
+	pace_next = pace_sim0 + pace_step;
+}
+
+// Returns 0 when not pacing.
+uint64_t
+board_pace_step(void)
+{
+	return pace_ratio > 0 ? pace_step : 0;
+}
+
+void
+board_pace(void)
+{
+	uint64_t sim = sim_now();
+	uint64_t wall = now_ns();
+	uint64_t due = pace_wall0 + (uint64_t)((sim - pace_sim0) * pace_tick_ns);
+
+	if (wall < due) {
+		struct timespec ts;
+		uint64_t ahead = due - wall;
+
+		ts.tv_sec = ahead / 1000000000;
+		ts.tv_nsec = ahead % 1000000000;
+		nanosleep(&ts, NULL);
+	} else if (wall - due > 100 * PACE_QUANTUM_NS) {
+		// Running behind: make the schedule start over from here rather
+		// than racing to catch up once the host frees up.
+		pace_rebase(sim, wall);
+	}
+
+	if (wall - pace_report_wall >= 1000000000) {
+		double achieved = (sim - pace_report_sim) * pace_tick_ns / (wall - pace_report_wall);
+		if (achieved < 0.99) {
+			printf("DE2: running at %.3f of the requested pace (%g sim s per wall s)\n",
+			    achieved, achieved * pace_ratio);
+			fflush(stdout);
+		}
+		pace_report_sim = sim;
+		pace_report_wall = wall;
+	}
+}
+
+//////// LIFECYCLE ////////
+
+void
+board_init(uint64_t (*now)(void), int precision)
+{
+	int i;
+
+	sim_now = now;
+	time_precision = precision;
+
+	sim_start = sim_now();
+	perf_init();
+
+	config_load();
+	for (i = 0; i < board_count(); i++)
+		board_limits_init(boards[i]);
+
+	if (stimulus_path != NULL)
+		stimulus_load(stimulus_path);
+	if (replay_path != NULL)
+		stimulus_load_log(replay_path, time_precision);
+	if (record_path != NULL)
+		stimulus_record_open(record_path, time_precision);
+
+	if (vcd_path != NULL) {
+		vcd_open(vcd_path, time_precision, sim_start);
+		for (i = 0; i < board_count(); i++)
+			vcd_board(i, boards[i]->inputs.switches, boards[i]->inputs.buttons);
+	}
+	initialized = 1;
+
+	if (trace_path != NULL)
+		trace_open(trace_path, sim_now, time_precision);
+
+	if (pace_ratio > 0)
+		pace_init();
+}
+
+void
+board_start(void)
+{
+	struct gui_config cfg;
+
+	// Headless, the switches & buttons simply keep their initial positions
+	// and, unless frames are captured, LED states are never handed off.
+	if (headless && capture_path == NULL)
+		return;
+
+	cfg.fps = render_fps;
+	cfg.headless = headless;
+	cfg.capture_path = capture_path;
+	cfg.capture_every = capture_every;
+	cfg.capture_depth = capture_depth;
+	gui_start(&cfg);
+	gui_running = 1;
+}
+
+static double
+sim_seconds(void)
+{
+	return (sim_now() - sim_start) * pow(10, time_precision);
+}
+
+void
+board_end(void)
+{
+	if (gui_running) {
+		gui_stop();
+		gui_running = 0;
+	}
+	if (record_path != NULL)
+		stimulus_record_close();
+	if (vcd_path != NULL)
+		vcd_close(sim_now());
+	trace_close();
+	perf_report(sim_seconds());
+}
+
+int
+board_headless(void)
+{
+	return headless;
+}
+
+// Backends call this at every service, which makes it the place to pick up
+// a SIGUSR1 request for a performance report too, and, on macOS, where the
+// GUI has no thread of its own, to run its frames.
+int
+board_quit_requested(void)
+{
+	perf_poll(sim_seconds);
+	if (gui_running)
+		gui_pump();
+	return gui_quit_requested();
+}
+
+void
+board_render(struct board *b)
+{
+	if (!gui_running || !rate_limit_pass(&b->render_limit))
+		return;
+
+	leds_integrate(b);
+	if (b->state.show_inputs)
+		b->state.inputs = b->inputs;
+	exchange_publish(&b->to_gui, &b->state);
+	gui_pump();
+}
+
+uint64_t
+board_service_interval(void)
+{
+	// Parsed on first use: a backend that never services the board, like
+	// DE2_replay, may run at a precision too coarse for the default.
+	if (service_interval == 0) {
+		service_interval = board_parse_time(service_interval_arg);
+		if (service_interval == 0)
+			errx(1, "+DE2_service_interval must be a positive time, e.g. 100us");
+	}
+	return service_interval;
+}
+
+// The whole of a periodic board service, for backends that have no better
+// place for each part: queued input, LED hand-off and, when due, pacing.
+// Pacing is process-wide, so with several boards whichever steps first
+// once it is due does it.
+int
+board_step(struct board *b)
+{
+	int changed = 0;
+
+	if (board_input_pending(b))
+		changed = board_apply_input(b);
+
+	board_render(b);
+
+	if (pace_ratio > 0 && sim_now() >= pace_next) {
+		board_pace();
+		pace_next = sim_now() + pace_step;
+	}
+	return changed;
+}
@@ -0,0 +1,109 @@
+#ifndef __DE2_BOARD__
+#define __DE2_BOARD__
+
+#include <stdint.h>
+
+#include "vec.h"
+
+#define LED_FULL (32)
+
+#define N_SW  (18)
+#define N_LED (18)
+#define N_BTN (4)
+
+enum input_kind {
+	INPUT_SWITCH,
+	INPUT_BUTTON,
+};
+
+#define INPUT_SWITCHES (1 << INPUT_SWITCH)
+#define INPUT_BUTTONS  (1 << INPUT_BUTTON)
+
+//////// SIMULATOR BACKEND INTERFACE ////////
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The board core (configuration, LED integration, GUI thread, input queue,
+// pacing), built as libDE2.a, knows nothing about the simulator driving it.
+// A backend (the VPI plugin, a Verilator harness or C++ testbench, GHDL)
+// feeds it LED states and sim time and picks up switch & button states,
+// all from the simulator thread. Vectors are packed as in vec.h.
+//
+// A process may simulate several boards, each with its own window and
+// state; configuration, pacing and the GUI thread are shared.
+#define MAX_BOARDS (16)
+
+struct board;
+
+// Plusargs (+name[=value]) configuring the board are taken from argv,
+// which must stay valid for the rest of the run.
+void board_args(int argc, char **argv);
+const char *board_plusarg_str(const char *name, const char *def);
+
+// Parse plusarg values, returning 0 if s is malformed: a time like "100us",
+// or a bare number of sim time units, into sim time units (only once
+// board_init has run), and a positive ratio like "1/1000".
+uint64_t board_parse_time(const char *s);
+double board_parse_ratio(const char *s);
+
+// Reads the configuration. now returns the current simulation time, in
+// units of 10^precision seconds.
+void board_init(uint64_t (*now)(void), int precision);
+void board_start(void);
+void board_end(void);
+
+// Set once a window is closed; the backend should end the simulation.
+int board_quit_requested(void);
+
+// Set by +DE2_headless or DE2_HEADLESS=1: there is no window.
+int board_headless(void);
+
+// Adds a board, with switches & buttons in their initial positions. Boards
+// may be added before or after board_init and board_start.
+struct board *board_new(void);
+
+// LED states, packed by vecidx.
+void board_set_leds(struct board *b, const uint32_t *on);
+// Hands LED states to the GUI, at most +DE2_fps times a second.
+void board_render(struct board *b);
+
+// Applies one batch of queued GUI input to the switch & button states,
+// returning which of INPUT_SWITCHES and INPUT_BUTTONS changed.
+int board_input_pending(struct board *b);
+int board_apply_input(struct board *b);
+// As board_apply_input, at most +DE2_poll_hz times a second.
+int board_poll_input(struct board *b);
+// Changes whenever the switch & button states do.
+unsigned board_input_gen(struct board *b);
+const uint32_t *board_switches(struct board *b);
+const uint32_t *board_buttons(struct board *b);
+
+// Sets the switch & button states from the backend rather than the user,
+// and shows the board's inputs in its window from the next board_render on;
+// for replaying a recorded run.
+void board_show_inputs(struct board *b, const uint32_t *switches, const uint32_t *buttons);
+
+// The sim time of the board's next scripted input (+DE2_stimulus), which
+// board_input_pending reports from then on, or UINT64_MAX if there is none.
+// Backends servicing the board periodically should also service it then.
+uint64_t board_next_input(struct board *b);
+
+// Sim time between board services (+DE2_service_interval).
+uint64_t board_service_interval(void);
+
+// With +DE2_pace, the backend calls board_pace every board_pace_step of
+// sim time; board_pace_step is 0 when not pacing.
+uint64_t board_pace_step(void);
+void board_pace(void);
+
+// Applies queued input, hands the LEDs to the GUI and paces as needed, all
+// in one call every board_service_interval. Returns as board_apply_input.
+int board_step(struct board *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,6 +8,30 @@ shift
 inst="$1"
 shift
 
-awk 'BEGIN{top=ARGV[2]; delete ARGV[2]} {print $0} /TOPMODULE/{print top}' DE2_top.v "$top $top ($inst);" > top.v
-iverilog -o "${top}.vvp" top.v "$@"
-vvp -M. -mDE2 "${top}.vvp"
+# +plusargs are passed to the board plugin, everything else is a source file.
+# Each function keeps the arguments it wants by rotating them through its
+# own "$@", so that paths are never split or globbed.
+compile() {
+	for arg; do
+		shift
+		case "$arg" in
+		+*) ;;
+		*) set -- "$@" "$arg" ;;
+		esac
+	done
+	iverilog -o "${top}.vvp" top.v "$@"
+}
+
+run() {
+	for arg; do
+		shift
+		case "$arg" in
+		+*) set -- "$@" "$arg" ;;
+		esac
+	done
+	vvp -M. -mDE2 "${top}.vvp" "$@"
+}
+
+awk 'BEGIN{top=ARGV[2]; delete ARGV[2]} {print $0} /^[ \t]*\/\/ TOPMODULE$/{print top}' DE2_top.v "$top $top ($inst);" > top.v
+compile "$@"
+run "$@"
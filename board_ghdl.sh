@@ -0,0 +1,44 @@
+#!/bin/sh
+
+set -e
+
+top="$1"
+shift
+
+inst="$1"
+shift
+
+# +plusargs are passed to the board through DE2_ARGS, everything else is a
+# source file. analyse keeps the sources by rotating them through its own
+# "$@", so that paths are never split or globbed.
+plusargs=""
+for arg in "$@"; do
+	case "$arg" in
+	+*) plusargs="$plusargs $arg" ;;
+	esac
+done
+
+GHDLFLAGS="--std=08 -fsynopsys"
+
+analyse() {
+	for arg; do
+		shift
+		case "$arg" in
+		+*) ;;
+		*) set -- "$@" "$arg" ;;
+		esac
+	done
+	ghdl -a $GHDLFLAGS DE2_board.vhd "$@" top.vhd
+}
+
+awk 'BEGIN{top=ARGV[2]; delete ARGV[2]} {print $0} /^[ \t]*-- TOPMODULE$/{print top}' DE2_top.vhd "	dut : entity work.$top port map ($inst);" > top.vhd
+analyse "$@"
+
+export DE2_ARGS="$plusargs"
+if ghdl --version | grep -q mcode; then
+	# mcode loads DE2_ghdl.so itself, see DE2_board.vhd
+	ghdl -r $GHDLFLAGS DE2_top
+else
+	ghdl -e $GHDLFLAGS -Wl,"$PWD/DE2_ghdl.so" DE2_top
+	./de2_top
+fi
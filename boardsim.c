@@ -1,140 +1,130 @@
 #include <err.h>
-#include "include/mti.h"
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-
-//////// BOARD I/O DECLARATIONS ////////
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vpi_user.h>
 
+#include "board.h"
 #include "buttons.h"
+#include "perf.h"
+#include "vec_vpi.h"
 
+// The VPI backend: systfs and callbacks through which Icarus (or any VPI
+// simulator) drives the board in board.c.
 
-#define ON   (1)
-#define OFF  (0)
-struct board_switch {
-	int vecidx;
-	int x;
-	int y;
-	int state;
-};
-
-struct board_led {
-	int vecidx;
-	int x;
-	int y;
-	int state;
-};
+//////// SIMULATION LIFECYCLE ////////
 
-struct board_switch switches[] = {
-#define sw_x(idx) lin_scale(84, 567, 18, idx)
-	{17, sw_x( 0), 604, OFF},
-	{16, sw_x( 1), 604, OFF},
-	{15, sw_x( 2), 604, OFF},
-	{14, sw_x( 3), 604, OFF},
-	{13, sw_x( 4), 604, OFF},
-	{12, sw_x( 5), 604, OFF},
-	{11, sw_x( 6), 604, OFF},
-	{10, sw_x( 7), 604, OFF},
-	{ 9, sw_x( 8), 604, OFF},
-	{ 8, sw_x( 9), 604, OFF},
-	{ 7, sw_x(10), 604, OFF},
-	{ 6, sw_x(11), 604, OFF},
-	{ 5, sw_x(12), 604, OFF},
-	{ 4, sw_x(13), 604, OFF},
-	{ 3, sw_x(14), 604, OFF},
-	{ 2, sw_x(15), 604, OFF},
-	{ 1, sw_x(16), 604, OFF},
-	{ 0, sw_x(17), 604, OFF},
-#undef sw_x
-};
-#define N_SW (sizeof(switches) / sizeof(switches[0]))
-
-struct board_led red_leds[] = {
-#define led_x(idx) lin_scale(88, 567, 18, idx)
-	{17, led_x( 0), 561, OFF},
-	{16, led_x( 1), 561, OFF},
-	{15, led_x( 2), 561, OFF},
-	{14, led_x( 3), 561, OFF},
-	{13, led_x( 4), 561, OFF},
-	{12, led_x( 5), 561, OFF},
-	{11, led_x( 6), 561, OFF},
-	{10, led_x( 7), 561, OFF},
-	{ 9, led_x( 8), 561, OFF},
-	{ 8, led_x( 9), 561, OFF},
-	{ 7, led_x(10), 561, OFF},
-	{ 6, led_x(11), 561, OFF},
-	{ 5, led_x(12), 561, OFF},
-	{ 4, led_x(13), 561, OFF},
-	{ 3, led_x(14), 561, OFF},
-	{ 2, led_x(15), 561, OFF},
-	{ 1, led_x(16), 561, OFF},
-	{ 0, led_x(17), 561, OFF},
-#undef led_x
-};
-#define N_LED (sizeof(red_leds) / sizeof(red_leds[0]))
+static uint64_t
+sim_now(void)
+{
+	s_vpi_time t;
+	t.type = vpiSimTime;
+	vpi_get_time(NULL, &t);
+	return ((uint64_t)(uint32_t)t.high << 32) | (uint32_t)t.low;
+}
 
-//////// Typedefs & structs ////////
+// Once the window is closed, end the simulation from the simulator thread.
+static void
+check_gui_quit(void)
+{
+	if (board_quit_requested())
+		vpi_control(vpiFinish, 0);
+}
 
-typedef struct {
-	mtiProcessIdT procid;
-	mtiSignalIdT buttons;
-	mtiSignalIdT switches;
-	mtiSignalIdT leds;
-} instanceInfoT;
+static PLI_INT32
+sim_end(p_cb_data cb_data)
+{
+	board_end();
+	return 0;
+}
 
-//////// FLP ////////
+static void leds_watch_by_name(void);
+static void pace_schedule(void);
 
-void checkValues( void * param )
+// Plusargs are only reliably available once the simulation starts, so the
+// board is set up from cbStartOfSimulation rather than at load time.
+static PLI_INT32
+sim_start(p_cb_data cb_data)
 {
-	double real_val;
-	instanceInfoT * inst = (instanceInfoT*)param;
-
-	mti_PrintFormatted( "Time [%d,%d] delta %d:\n",
-		mti_NowUpper(),
-		mti_Now(),
-		mti_Delta()
-	);
-	// mti_PrintFormatted( " %s = %d\n",
-	// 	mti_GetSignalName( inst->bitsig ),
-	// 	mti_GetSignalValue( inst->bitsig )
-	// );
-	// mti_PrintFormatted( " %s = %d\n",
-	// 	mti_GetSignalName( inst->intsig ),
-	// 	mti_GetSignalValue( inst->intsig )
-	// );
-	// (void) mti_GetSignalValueIndirect( inst->realsig, &real_val );
-	// mti_PrintFormatted( " %s = %g\n",
-	// 	mti_GetSignalName( inst->realsig ),
-	// 	real_val
-	// );
-	mti_ScheduleWakeup( inst->procid, 5 );
+	s_vpi_vlog_info info;
+	s_cb_data cb;
+
+	if (vpi_get_vlog_info(&info))
+		board_args(info.argc, info.argv);
+	board_init(sim_now, vpi_get(vpiTimePrecision, NULL));
+	board_start();
+
+	leds_watch_by_name();
+	if (board_pace_step() != 0)
+		pace_schedule();
+
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbEndOfSimulation;
+	cb.cb_rtn = sim_end;
+	vpi_register_cb(&cb);
+	return 0;
 }
 
-void cleanupCallback( void * param )
+void
+DE2_start_register(void)
 {
-	mti_PrintMessage( "Cleaning up...\n" );
-	free( param );
+	s_cb_data cb;
+
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbStartOfSimulation;
+	cb.cb_rtn = sim_start;
+	vpi_register_cb(&cb);
 }
 
-void app_init(
-	mtiRegionIdT region,
-	char* param,
-	mtiInterfaceListT *generics,
-	mtiInterfaceListT *ports
-) {
-	instanceInfoT* inst = (instanceInfoT*)malloc( sizeof(instanceInfoT) );
-	inst->switches = mti_FindPort( ports, "switches" );
-	inst->buttons = mti_FindPort( ports, "buttons" );
-	inst->leds = mti_FindPort( ports, "leds" );
 
-	inst->procid = mti_CreateProcess( "ValueChecker", checkValues, inst );
+//////// BOARDS ////////
 
-	mti_AddQuitCB( cleanupCallback, inst );
-	mti_AddRestartCB( cleanupCallback, inst );
+// Every $DE2_sync or $DE2_attach call, i.e. every instance of a wrapper
+// calling them, drives a board of its own, kept with its other state as
+// the call's user data. The older one-job tasks ($DE2_leds, $DE2_switches,
+// ...) all share a single default board, created by the first of them.
+static struct board *default_board;
+
+struct board *
+DE2_default_board(void)
+{
+	if (default_board == NULL)
+		default_board = board_new();
+	return default_board;
+}
+
+// Boards are best created at compile time, so that their windows are
+// already up when the simulation starts.
+PLI_INT32
+DE2_default_compiletf(PLI_BYTE8 *user_data)
+{
+	DE2_default_board();
+	return 0;
 }
 
 
 //////// LEDS ////////
 
+// Each $DE2_leds call site resolves its argument once, in compiletf, and
+// keeps the handle as the systf call's user data, so that calltf is a
+// single vpi_get_value. Systfs taking arguments follow the same pattern.
+//
+// Alternatively, $DE2_leds_watch(leds), called once, or +DE2_leds_net=name
+// make the plugin follow the LEDs through a cbValueChange callback, so the
+// HDL needs no process re-reading them, and unchanging LEDs cost nothing.
+
+// For vector represenation, see "The Verilog PLI Handbook" section 5.2.7 "Reading Verilog 4-state logic vectors as encoded aval/bval pairs" (1st edition page 150, 2nd edition page 163)
+static void
+leds_update_vec(struct board *b, const s_vpi_vecval *vec)
+{
+	uint32_t on[VEC_WORDS(N_LED)];
+
+	// An LED is only lit by a known 1; X and Z leave it dark.
+	vec_ones(vec, on, N_LED);
+	board_set_leds(b, on);
+}
+
+// user_data is the systf name, for the error message.
 PLI_INT32
 DE2_leds_compiletf(PLI_BYTE8 *user_data)
 {
@@ -158,11 +148,13 @@ DE2_leds_compiletf(PLI_BYTE8 *user_data)
 	if (vpi_scan(iter) != NULL) // must not have >1 arg
 		goto fail;
 
+	vpi_put_userdata(systf, arg);
+	DE2_default_board();
 	return 0;
 
 	// We are leaking an iter in some cases, but vpi_free_object(iter) double-frees if used after vpi_scan returns NULL and frees non-alloc'd if used before scanning, so it's significantly more readable (and non-problematic since in _complie) to just leak. See handbook section 4.5.3 "When to use vpi_free_object() on iterator handles" (2nd edition page 108)
 fail:
-	vpi_printf("ERROR: $DE2_leds() requires exactly one %lu-bit wide vector argument\n", N_LED);
+	vpi_printf("ERROR: %s() requires exactly one %d-bit wide vector argument\n", user_data, N_LED);
 	vpi_control(vpiFinish, 1);
 	return 0;
 }
@@ -170,31 +162,88 @@ fail:
 PLI_INT32
 DE2_leds_calltf(PLI_BYTE8 *user_data)
 {
-	vpiHandle systf, iter, vec;
+	vpiHandle vec;
 	s_vpi_value val;
-	PLI_INT32 aval, bval;
-
-	systf = vpi_handle(vpiSysTfCall, NULL);
-	iter = vpi_iterate(vpiArgument, systf);
-	vec = vpi_scan(iter);
-	vpi_free_object(iter);
 
-	// For vector represenation, see "The Verilog PLI Handbook" section 5.2.7 "Reading Verilog 4-state logic vectors as encoded aval/bval pairs" (1st edition page 150, 2nd edition page 163)
+	PERF_BEGIN(PERF_LEDS);
+	vec = vpi_get_userdata(vpi_handle(vpiSysTfCall, NULL));
 
 	val.format = vpiVectorVal;
 	vpi_get_value(vec, &val);
-	aval = val.value.vector[0].aval;
-	bval = val.value.vector[0].bval;
+	leds_update_vec(DE2_default_board(), val.value.vector);
+	PERF_END(PERF_LEDS);
 
-	size_t i;
-	for (i = 0; i < sizeof(red_leds) / sizeof(red_leds[0]); i++) {
-		PLI_INT32 mask = (1 << (N_LED - 1)) >> i;
-		red_leds[i].state = ((aval & mask) && !(bval & mask)) ? ON : OFF;
-	}
+	return 0;
+}
 
+static PLI_INT32
+leds_changed(p_cb_data cb_data)
+{
+	PERF_BEGIN(PERF_LEDS_CHANGED);
+	leds_update_vec((struct board *)cb_data->user_data, cb_data->value->value.vector);
+	PERF_END(PERF_LEDS_CHANGED);
 	return 0;
 }
 
+static void
+leds_watch(struct board *b, vpiHandle net)
+{
+	static s_vpi_time time = { vpiSuppressTime };
+	static s_vpi_value value = { vpiVectorVal };
+	s_cb_data cb;
+	s_vpi_value val;
+
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbValueChange;
+	cb.cb_rtn = leds_changed;
+	cb.obj = net;
+	cb.time = &time;
+	cb.value = &value;
+	cb.user_data = (PLI_BYTE8 *)b;
+	if (vpi_register_cb(&cb) == NULL)
+		errx(1, "cannot watch LEDs: cbValueChange registration failed");
+
+	// Pick up whatever the LEDs already show.
+	val.format = vpiVectorVal;
+	vpi_get_value(net, &val);
+	leds_update_vec(b, val.value.vector);
+}
+
+PLI_INT32
+DE2_leds_watch_calltf(PLI_BYTE8 *user_data)
+{
+	vpiHandle systf = vpi_handle(vpiSysTfCall, NULL);
+	vpiHandle net = vpi_get_userdata(systf);
+
+	// A call site only ever registers one callback, however often it runs.
+	if (net != NULL) {
+		leds_watch(DE2_default_board(), net);
+		vpi_put_userdata(systf, NULL);
+	}
+	return 0;
+}
+
+static void
+leds_watch_by_name(void)
+{
+	const char *name = board_plusarg_str("DE2_leds_net", NULL);
+	vpiHandle net;
+	PLI_INT32 type;
+
+	if (name == NULL)
+		return;
+
+	net = vpi_handle_by_name((PLI_BYTE8 *)name, NULL);
+	if (net == NULL)
+		errx(1, "+DE2_leds_net: no such object: %s", name);
+
+	type = vpi_get(vpiType, net);
+	if ((type != vpiNet && type != vpiReg) || vpi_get(vpiSize, net) != N_LED)
+		errx(1, "+DE2_leds_net: %s is not a %d-bit vector", name, N_LED);
+
+	leds_watch(DE2_default_board(), net);
+}
+
 void
 DE2_leds_register(void)
 {
@@ -206,34 +255,35 @@ DE2_leds_register(void)
 	tf_data.calltf = DE2_leds_calltf;
 	tf_data.compiletf = DE2_leds_compiletf;
 	tf_data.sizetf = NULL;
-	tf_data.user_data = NULL;
+	tf_data.user_data = "$DE2_leds";
 
 	vpi_register_systf(&tf_data);
 }
 
-//////// SWITCHES ////////
-
-PLI_INT32
-DE2_switches_calltf(PLI_BYTE8 *user_data)
+void
+DE2_leds_watch_register(void)
 {
-	vpiHandle systf;
-	s_vpi_value val;
-	s_vpi_vecval vec0;
-
-	systf = vpi_handle(vpiSysTfCall, NULL);
+	s_vpi_systf_data tf_data;
 
-	val.format = vpiVectorVal;
-	val.value.vector = &vec0;
-	vec0.aval = 0;
-	vec0.bval = 0;
+	tf_data.type = vpiSysTask;
+	tf_data.sysfunctype = 0;
+	tf_data.tfname = "$DE2_leds_watch";
+	tf_data.calltf = DE2_leds_watch_calltf;
+	tf_data.compiletf = DE2_leds_compiletf;
+	tf_data.sizetf = NULL;
+	tf_data.user_data = "$DE2_leds_watch";
 
-	size_t i;
-	for (i = 0; i < N_SW; i++)
-		if (switches[i].state)
-			vec0.aval |= (1 << (N_SW - 1)) >> i;
+	vpi_register_systf(&tf_data);
+}
 
-	vpi_put_value(systf, &val, NULL, vpiNoDelay);
+//////// SWITCHES ////////
 
+PLI_INT32
+DE2_switches_calltf(PLI_BYTE8 *user_data)
+{
+	PERF_BEGIN(PERF_SWITCHES);
+	vec_put(vpi_handle(vpiSysTfCall, NULL), board_switches(DE2_default_board()), N_SW);
+	PERF_END(PERF_SWITCHES);
 	return 0;
 }
 
@@ -252,223 +302,343 @@ DE2_switches_register(void)
 	tf_data.sysfunctype = vpiSizedFunc;
 	tf_data.tfname = "$DE2_switches";
 	tf_data.calltf = DE2_switches_calltf;
-	tf_data.compiletf = NULL;
+	tf_data.compiletf = DE2_default_compiletf;
 	tf_data.sizetf = DE2_switches_sizetf;
 	tf_data.user_data = NULL;
 
 	vpi_register_systf(&tf_data);
 }
 
+//////// GUI SHIMS ////////
 
-//////// GUI ////////
-
-SDL_Window *window;
-SDL_Surface *screen;
-SDL_Surface *board_texture;
-SDL_Surface *led_texture;
-SDL_Surface *one_texture;
-SDL_Surface *zero_texture;
-
-static void
-handle_button(struct board_button *b, int updown)
+PLI_INT32
+DE2_render(PLI_BYTE8 *user_data)
 {
-	b->state = updown;
+	PERF_BEGIN(PERF_RENDER_TF);
+	board_render(DE2_default_board());
+	check_gui_quit();
+	PERF_END(PERF_RENDER_TF);
+	return 0;
 }
 
-static void
-handle_switch(struct board_switch *sw)
+void
+DE2_render_register(void)
 {
-	sw->state = !sw->state;
+	s_vpi_systf_data tf_data;
+
+	tf_data.type = vpiSysTask;
+	tf_data.sysfunctype = 0;
+	tf_data.tfname = "$DE2_render";
+	tf_data.calltf = DE2_render;
+	tf_data.compiletf = DE2_default_compiletf;
+	tf_data.sizetf = NULL;
+	tf_data.user_data = NULL;
+
+	vpi_register_systf(&tf_data);
 }
 
-static struct board_switch *
-find_switch(int x, int y)
+PLI_INT32
+DE2_handle_input(PLI_BYTE8 *user_data)
 {
-	size_t i;
-	for (i = 0; i < sizeof(switches) / sizeof(switches[0]); i++)
-		if (abs(switches[i].x - x) < 10 &&
-		    abs(switches[i].y - y) < 20)
-			return &switches[i];
-	return NULL;
+	PERF_BEGIN(PERF_HANDLE_INPUT_TF);
+	board_poll_input(DE2_default_board());
+	check_gui_quit();
+	PERF_END(PERF_HANDLE_INPUT_TF);
+	return 0;
 }
 
-static struct board_button *
-find_button(SDL_Keycode k)
+void
+DE2_handle_input_register(void)
 {
-	size_t i;
-	for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++)
-		if (buttons[i].sym == k)
-			return &buttons[i];
-	return NULL;
-}
+	s_vpi_systf_data tf_data;
 
-static void
-handle_input(void)
-{
-	SDL_Event e;
-
-	while (SDL_PollEvent(&e)) {
-		switch (e.type) {
-		case SDL_MOUSEBUTTONDOWN: {
-			struct board_switch *sw = find_switch(e.button.x, e.button.y);
-			if (sw != NULL)
-				handle_switch(sw);
-			break;
-		}
-
-		case SDL_KEYDOWN:
-		case SDL_KEYUP: {
-			struct board_button *b = find_button(e.key.keysym.sym);
-			if (b != NULL)
-				handle_button(b, e.type == SDL_KEYDOWN ? DOWN : UP);
-			break;
-		}
-
-		case SDL_QUIT:
-			exit(0);
-			break;
-		}
-	}
+	tf_data.type = vpiSysTask;
+	tf_data.sysfunctype = 0;
+	tf_data.tfname = "$DE2_handle_input";
+	tf_data.calltf = DE2_handle_input;
+	tf_data.compiletf = DE2_default_compiletf;
+	tf_data.sizetf = NULL;
+	tf_data.user_data = NULL;
+
+	vpi_register_systf(&tf_data);
 }
 
-static SDL_Surface *
-xload_img(const char *path)
+//////// FUSED SYNC ////////
+
+// $DE2_sync(leds, switches, buttons[, render]) does the work of
+// $DE2_handle_input, $DE2_switches, $DE2_buttons, $DE2_leds and, if the
+// constant render argument is nonzero, $DE2_render, in one VPI crossing.
+// switches and buttons are regs it writes, only when they changed.
+//
+// $DE2_attach takes the same arguments but is called once; the plugin then
+// services the board itself every +DE2_service_interval of sim time,
+// writing switches and buttons only when the GUI queued a change.
+
+struct sync_site {
+	struct board *board;
+	vpiHandle leds;
+	vpiHandle switches;
+	vpiHandle buttons;
+	int render;
+	int written;          // switches & buttons hold some board_input_gen
+	unsigned written_gen; // ...namely this one
+	int attached;
+};
+
+static int
+sync_check_vec(vpiHandle arg, PLI_INT32 type, int size)
 {
-	SDL_Surface *s;
-	s = IMG_Load(path);
-	if (s == NULL)
-		err(1, "IMG_Load: %s", IMG_GetError());
-	return s;
+	return arg != NULL && vpi_get(vpiType, arg) == type && vpi_get(vpiSize, arg) == size;
 }
 
-void
-gui_init(void)
+PLI_INT32
+DE2_sync_compiletf(PLI_BYTE8 *user_data)
 {
-	if (SDL_Init(SDL_INIT_VIDEO) == -1)
-		err(1, "SDL_Init: %s", SDL_GetError());
+	vpiHandle systf, iter, arg;
+	struct sync_site *site;
+	s_vpi_value val;
 
-	int flags = IMG_INIT_PNG;
-	if ((IMG_Init(flags) & flags) != flags)
-		err(1, "IMG_Init: %s", IMG_GetError());
+	systf = vpi_handle(vpiSysTfCall, NULL);
+	iter = vpi_iterate(vpiArgument, systf);
+	if (iter == NULL)
+		goto fail;
 
-	board_texture = xload_img("DE2.png");
-	led_texture = xload_img("led.png");
-	zero_texture = xload_img("0.png");
-	one_texture = xload_img("1.png");
+	site = calloc(1, sizeof(*site));
+	if (site == NULL)
+		err(1, "calloc");
 
-	window = SDL_CreateWindow("board", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, board_texture->w, board_texture->h, SDL_WINDOW_SHOWN);
-	if (window == NULL)
-		err(1, "SDL_CreateWindow: %s", SDL_GetError());
+	site->leds = vpi_scan(iter);
+	if (!sync_check_vec(site->leds, vpiNet, N_LED))
+		goto fail;
 
-	screen = SDL_GetWindowSurface(window);
-	if (screen == NULL)
-		err(1, "SDL_GetWindowSurface: %s", SDL_GetError());
+	site->switches = vpi_scan(iter);
+	if (!sync_check_vec(site->switches, vpiReg, N_SW))
+		goto fail;
+
+	site->buttons = vpi_scan(iter);
+	if (!sync_check_vec(site->buttons, vpiReg, N_BTN))
+		goto fail;
+
+	// Same leaking of iter as in DE2_leds_compiletf.
+	arg = vpi_scan(iter);
+	if (arg != NULL) {
+		if (vpi_get(vpiType, arg) != vpiConstant || vpi_scan(iter) != NULL)
+			goto fail;
+
+		val.format = vpiIntVal;
+		vpi_get_value(arg, &val);
+		site->render = val.value.integer != 0;
+	}
+
+	site->board = board_new();
+	vpi_put_userdata(systf, site);
+	return 0;
+
+fail:
+	vpi_printf("ERROR: %s() requires a %d-bit LED net, a %d-bit switch reg, a %d-bit button reg, and optionally a constant render flag\n", user_data, N_LED, N_SW, N_BTN);
+	vpi_control(vpiFinish, 1);
+	return 0;
 }
 
+static void sync_put_inputs(struct sync_site *site, int which);
+
 static void
-blit_centered(SDL_Surface *texture, int x, int y)
+sync_service(struct sync_site *site)
 {
-	SDL_Rect dr;
-	dr.w = texture->w;
-	dr.h = texture->h;
+	uint32_t on[VEC_WORDS(N_LED)];
+
+	board_poll_input(site->board);
+
+	if (!site->written || site->written_gen != board_input_gen(site->board)) {
+		sync_put_inputs(site, INPUT_SWITCHES | INPUT_BUTTONS);
+		site->written = 1;
+		site->written_gen = board_input_gen(site->board);
+	}
+
+	vec_get(site->leds, on, N_LED);
+	board_set_leds(site->board, on);
 
-	dr.x = x - dr.w/2;
-	dr.y = y - dr.h/2;
+	if (site->render)
+		board_render(site->board);
 
-	if (SDL_BlitSurface(texture, NULL, screen, &dr) < 0)
-		err(1, "SDL_BlitSurface(texture): %s", SDL_GetError());
+	check_gui_quit();
 }
 
-static void
-draw_leds(void)
+PLI_INT32
+DE2_sync_calltf(PLI_BYTE8 *user_data)
 {
-	size_t i;
-	for (i = 0; i < sizeof(red_leds) / sizeof(red_leds[0]); i++)
-		if (red_leds[i].state) // XXX TODO: variable opacity?
-			blit_centered(led_texture, red_leds[i].x, red_leds[i].y);
+	PERF_BEGIN(PERF_SYNC);
+	sync_service(vpi_get_userdata(vpi_handle(vpiSysTfCall, NULL)));
+	PERF_END(PERF_SYNC);
+	return 0;
 }
 
 static void
-draw_input_states(void)
+sync_put_inputs(struct sync_site *site, int which)
 {
-	size_t i;
+	if (which & INPUT_SWITCHES)
+		vec_put(site->switches, board_switches(site->board), N_SW);
+	if (which & INPUT_BUTTONS)
+		vec_put(site->buttons, board_buttons(site->board), N_BTN);
+}
+
+static void service_schedule(struct sync_site *site);
 
-	for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++)
-		blit_centered(buttons[i].state ? one_texture : zero_texture, buttons[i].x, buttons[i].y);
+// Queued input lands here, once everything scheduled for the service time
+// has settled, so it reaches the design at a service boundary.
+static PLI_INT32
+service_inputs(p_cb_data cb_data)
+{
+	struct sync_site *site = (struct sync_site *)cb_data->user_data;
 
-	for (i = 0; i < sizeof(switches) / sizeof(switches[0]); i++)
-		blit_centered(switches[i].state ? one_texture : zero_texture, switches[i].x, switches[i].y);
+	PERF_BEGIN(PERF_SERVICE_INPUT);
+	sync_put_inputs(site, board_apply_input(site->board));
+	PERF_END(PERF_SERVICE_INPUT);
+	return 0;
 }
 
-void
-render(void)
+// An attached site follows its LEDs by value change, so an idle service tick
+// makes no VPI calls beyond rearming itself.
+static PLI_INT32
+service_tick(p_cb_data cb_data)
 {
-	if (SDL_BlitSurface(board_texture, NULL, screen, NULL) < 0)
-		err(1, "SDL_BlitSurface(board_texture): %s", SDL_GetError());
+	static s_vpi_time now = { vpiSimTime, 0, 0 };
+	struct sync_site *site = (struct sync_site *)cb_data->user_data;
+	s_cb_data cb;
+
+	PERF_BEGIN(PERF_SERVICE);
+	if (board_input_pending(site->board)) {
+		memset(&cb, 0, sizeof(cb));
+		cb.reason = cbReadWriteSynch;
+		cb.cb_rtn = service_inputs;
+		cb.time = &now;
+		cb.user_data = (PLI_BYTE8 *)site;
+		vpi_register_cb(&cb);
+	}
 
-	draw_leds();
-	draw_input_states();
+	if (site->render)
+		board_render(site->board);
 
-	if (SDL_UpdateWindowSurface(window) < 0)
-		err(1, "SDL_UpdateWindowSurface: %s", SDL_GetError());
+	check_gui_quit();
+	service_schedule(site);
+	PERF_END(PERF_SERVICE);
+	return 0;
 }
 
-//////// SDL<->VPI GUI SHIMS ////////
+static void
+service_schedule(struct sync_site *site)
+{
+	uint64_t interval = board_service_interval();
+	uint64_t now = sim_now(), next = board_next_input(site->board);
+	s_vpi_time delay;
+	s_cb_data cb;
+
+	// Scripted input lands at its own time, not at the next service.
+	if (next < now + interval)
+		interval = next > now ? next - now : 1;
+
+	delay.type = vpiSimTime;
+	delay.high = (PLI_UINT32)(interval >> 32);
+	delay.low = (PLI_UINT32)interval;
+
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbAfterDelay;
+	cb.cb_rtn = service_tick;
+	cb.time = &delay;
+	cb.user_data = (PLI_BYTE8 *)site;
+	if (vpi_register_cb(&cb) == NULL)
+		errx(1, "$DE2_attach: cbAfterDelay registration failed");
+}
 
 PLI_INT32
-DE2_render(PLI_BYTE8 *user_data)
+DE2_attach_calltf(PLI_BYTE8 *user_data)
 {
-	render();
+	struct sync_site *site = vpi_get_userdata(vpi_handle(vpiSysTfCall, NULL));
+
+	if (!site->attached) {
+		site->attached = 1;
+		leds_watch(site->board, site->leds);
+		sync_put_inputs(site, INPUT_SWITCHES | INPUT_BUTTONS);
+		service_schedule(site);
+	}
 	return 0;
 }
 
 void
-DE2_render_register(void)
+DE2_sync_register(void)
 {
 	s_vpi_systf_data tf_data;
 
 	tf_data.type = vpiSysTask;
 	tf_data.sysfunctype = 0;
-	tf_data.tfname = "$DE2_render";
-	tf_data.calltf = DE2_render;
-	tf_data.compiletf = NULL;
+	tf_data.tfname = "$DE2_sync";
+	tf_data.calltf = DE2_sync_calltf;
+	tf_data.compiletf = DE2_sync_compiletf;
 	tf_data.sizetf = NULL;
-	tf_data.user_data = NULL;
+	tf_data.user_data = "$DE2_sync";
 
 	vpi_register_systf(&tf_data);
 }
 
-PLI_INT32
-DE2_handle_input(PLI_BYTE8 *user_data)
-{
-	handle_input();
-	return 0;
-}
-
 void
-DE2_handle_input_register(void)
+DE2_attach_register(void)
 {
 	s_vpi_systf_data tf_data;
 
 	tf_data.type = vpiSysTask;
 	tf_data.sysfunctype = 0;
-	tf_data.tfname = "$DE2_handle_input";
-	tf_data.calltf = DE2_handle_input;
-	tf_data.compiletf = NULL;
+	tf_data.tfname = "$DE2_attach";
+	tf_data.calltf = DE2_attach_calltf;
+	tf_data.compiletf = DE2_sync_compiletf;
 	tf_data.sizetf = NULL;
-	tf_data.user_data = NULL;
+	tf_data.user_data = "$DE2_attach";
 
 	vpi_register_systf(&tf_data);
 }
 
+//////// REAL-TIME PACING ////////
+
+// With +DE2_pace, a cbAfterDelay chain lets board_pace hold the simulation
+// back to the requested rate.
+static PLI_INT32
+pace_tick(p_cb_data cb_data)
+{
+	board_pace();
+	pace_schedule();
+	return 0;
+}
+
+static void
+pace_schedule(void)
+{
+	uint64_t step = board_pace_step();
+	s_vpi_time delay;
+	s_cb_data cb;
+
+	delay.type = vpiSimTime;
+	delay.high = (PLI_UINT32)(step >> 32);
+	delay.low = (PLI_UINT32)step;
+
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbAfterDelay;
+	cb.cb_rtn = pace_tick;
+	cb.time = &delay;
+	if (vpi_register_cb(&cb) == NULL)
+		errx(1, "+DE2_pace: cbAfterDelay registration failed");
+}
+
+
 //////// VPI REGISTRATION ////////
 
 void (*vlog_startup_routines[])() = {
-	gui_init,
+	DE2_start_register,
 	DE2_leds_register,
+	DE2_leds_watch_register,
 	DE2_switches_register,
 	DE2_buttons_register,
 	DE2_render_register,
 	DE2_handle_input_register,
+	DE2_sync_register,
+	DE2_attach_register,
 	0
 };
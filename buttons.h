@@ -1,20 +1,14 @@
 #ifndef __DE2_BUTTONS__
 #define __DE2_BUTTONS__
 
-#include <SDL2/SDL.h>
+#include <vpi_user.h>
 
-#define lin_scale(start, stop, count, idx) (((stop)-(start))*(idx)/((count)-1)+(start))
+#include "board.h"
 
-#define UP   (1)
-#define DOWN (0)
-
-struct board_button {
-	SDL_Keycode sym;
-	int vecidx;
-	int x;
-	int y;
-	int state;
-};
+// The board shared by the one-job tasks, and a compiletf creating it; see
+// boardsim.c.
+struct board *DE2_default_board(void);
+PLI_INT32 DE2_default_compiletf(PLI_BYTE8 *user_data);
 
 PLI_INT32 DE2_buttons_calltf(PLI_BYTE8 *user_data);
 
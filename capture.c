@@ -0,0 +1,253 @@
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include "capture.h"
+
+#define CAPTURE_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+static struct {
+	int w, h;
+
+	// Ring of preallocated frames. The GUI thread fills slot[tail] while
+	// it is outside [head, head + count), then publishes it under lock.
+	Uint32 **slot;
+	int depth;
+	int head, tail, count;
+	int closing;
+	SDL_mutex *lock;
+	SDL_cond *cond;
+	SDL_Thread *thread;
+
+	unsigned long written;
+	unsigned long dropped;
+
+	FILE *y4m;            // Y4M stream, or
+	char pattern[1024];   // PNG file name pattern
+	Uint8 *yuv;           // one Y4M frame's planes
+} cap;
+
+static void
+write_y4m(const Uint32 *px)
+{
+	size_t n = (size_t)cap.w * cap.h;
+	Uint8 *y = cap.yuv, *u = y + n, *v = u + n;
+	size_t i;
+
+	// BT.601 studio swing, which is what Y4M readers assume.
+	for (i = 0; i < n; i++) {
+		int r = (px[i] >> 16) & 0xff;
+		int g = (px[i] >> 8) & 0xff;
+		int b = px[i] & 0xff;
+
+		y[i] = (( 66 * r + 129 * g +  25 * b + 128) >> 8) +  16;
+		u[i] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+		v[i] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+	}
+
+	fputs("FRAME\n", cap.y4m);
+	if (fwrite(cap.yuv, 1, 3 * n, cap.y4m) != 3 * n)
+		err(1, "capture: fwrite");
+}
+
+static void
+write_png(Uint32 *px)
+{
+	char path[1100];
+	SDL_Surface *s;
+
+	snprintf(path, sizeof(path), cap.pattern, (int)cap.written);
+
+	s = SDL_CreateRGBSurfaceWithFormatFrom(px, cap.w, cap.h, 32, cap.w * 4, CAPTURE_FORMAT);
+	if (s == NULL)
+		err(1, "SDL_CreateRGBSurfaceWithFormatFrom: %s", SDL_GetError());
+	if (IMG_SavePNG(s, path) < 0)
+		err(1, "IMG_SavePNG(%s): %s", path, IMG_GetError());
+	SDL_FreeSurface(s);
+}
+
+static int
+encoder_main(void *arg)
+{
+	for (;;) {
+		Uint32 *px;
+
+		SDL_LockMutex(cap.lock);
+		while (cap.count == 0 && !cap.closing)
+			SDL_CondWait(cap.cond, cap.lock);
+		if (cap.count == 0) {
+			SDL_UnlockMutex(cap.lock);
+			return 0;
+		}
+		px = cap.slot[cap.head];
+		SDL_UnlockMutex(cap.lock);
+
+		if (cap.y4m != NULL)
+			write_y4m(px);
+		else
+			write_png(px);
+
+		SDL_LockMutex(cap.lock);
+		cap.head = (cap.head + 1) % cap.depth;
+		cap.count--;
+		cap.written++;
+		SDL_UnlockMutex(cap.lock);
+	}
+}
+
+static int
+has_suffix(const char *s, const char *suffix)
+{
+	size_t n = strlen(s), m = strlen(suffix);
+	return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// The PNG name pattern is handed to snprintf, so it may hold one integer
+// conversion, "%d" or e.g. "%06d", plus any number of "%%", and nothing else.
+static void
+check_pattern(const char *pattern)
+{
+	const char *p;
+	int conversions = 0;
+
+	for (p = strchr(pattern, '%'); p != NULL; p = strchr(p, '%')) {
+		p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+		p += strspn(p, "0");
+		p += strspn(p, "0123456789");
+		if (*p != 'd' || ++conversions > 1)
+			errx(1, "capture: %s: a pattern takes a single %%d, e.g. cap/%%06d.png", pattern);
+	}
+	if (conversions == 0)
+		errx(1, "capture: %s: a pattern takes a single %%d, e.g. cap/%%06d.png", pattern);
+}
+
+// Fails now, rather than at the first frame the encoder writes, if the
+// directory the PNGs go in is not there.
+static void
+check_directory(const char *pattern)
+{
+	char first[sizeof(cap.pattern) + 16], *slash;
+	struct stat st;
+
+	snprintf(first, sizeof(first), pattern, 0);
+	if ((slash = strrchr(first, '/')) == NULL)
+		return;
+	if (slash == first)
+		slash++;
+	*slash = '\0';
+
+	if (stat(first, &st) < 0)
+		err(1, "capture: %s", first);
+	if (!S_ISDIR(st.st_mode))
+		errx(1, "capture: %s: not a directory", first);
+}
+
+void
+capture_open(const char *path, int w, int h, int fps, int every, int depth)
+{
+	int i;
+
+	cap.w = w;
+	cap.h = h;
+	cap.depth = depth;
+
+	if (has_suffix(path, ".y4m")) {
+		cap.y4m = fopen(path, "wb");
+		if (cap.y4m == NULL)
+			err(1, "capture: %s", path);
+		fprintf(cap.y4m, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n", w, h, fps, every);
+
+		cap.yuv = malloc((size_t)w * h * 3);
+		if (cap.yuv == NULL)
+			err(1, "capture: malloc");
+	} else if (strchr(path, '%') != NULL) {
+		check_pattern(path);
+		snprintf(cap.pattern, sizeof(cap.pattern), "%s", path);
+		check_directory(cap.pattern);
+	} else {
+		snprintf(cap.pattern, sizeof(cap.pattern), "%s/frame%%06d.png", path);
+		check_directory(cap.pattern);
+	}
+
+	cap.slot = calloc(depth, sizeof(*cap.slot));
+	if (cap.slot == NULL)
+		err(1, "capture: calloc");
+	for (i = 0; i < depth; i++) {
+		cap.slot[i] = malloc((size_t)w * h * 4);
+		if (cap.slot[i] == NULL)
+			err(1, "capture: malloc");
+	}
+
+	cap.lock = SDL_CreateMutex();
+	cap.cond = SDL_CreateCond();
+	if (cap.lock == NULL || cap.cond == NULL)
+		err(1, "capture: %s", SDL_GetError());
+
+	cap.thread = SDL_CreateThread(encoder_main, "DE2 capture", NULL);
+	if (cap.thread == NULL)
+		err(1, "SDL_CreateThread: %s", SDL_GetError());
+}
+
+void
+capture_frame(SDL_Surface *s)
+{
+	int full;
+
+	SDL_LockMutex(cap.lock);
+	full = cap.count == cap.depth;
+	if (full)
+		cap.dropped++;
+	SDL_UnlockMutex(cap.lock);
+
+	if (full)
+		return;
+
+	if (SDL_MUSTLOCK(s))
+		SDL_LockSurface(s);
+	if (SDL_ConvertPixels(cap.w, cap.h, s->format->format, s->pixels, s->pitch,
+	    CAPTURE_FORMAT, cap.slot[cap.tail], cap.w * 4) < 0)
+		err(1, "SDL_ConvertPixels: %s", SDL_GetError());
+	if (SDL_MUSTLOCK(s))
+		SDL_UnlockSurface(s);
+
+	SDL_LockMutex(cap.lock);
+	cap.tail = (cap.tail + 1) % cap.depth;
+	cap.count++;
+	SDL_CondSignal(cap.cond);
+	SDL_UnlockMutex(cap.lock);
+}
+
+void
+capture_close(unsigned long *written, unsigned long *dropped)
+{
+	int i;
+
+	SDL_LockMutex(cap.lock);
+	cap.closing = 1;
+	SDL_CondSignal(cap.cond);
+	SDL_UnlockMutex(cap.lock);
+
+	SDL_WaitThread(cap.thread, NULL);
+
+	if (cap.y4m != NULL && fclose(cap.y4m) != 0)
+		err(1, "capture: fclose");
+
+	for (i = 0; i < cap.depth; i++)
+		free(cap.slot[i]);
+	free(cap.slot);
+	free(cap.yuv);
+	SDL_DestroyCond(cap.cond);
+	SDL_DestroyMutex(cap.lock);
+
+	*written = cap.written;
+	*dropped = cap.dropped;
+}
@@ -0,0 +1,24 @@
+#ifndef __DE2_CAPTURE__
+#define __DE2_CAPTURE__
+
+#include <SDL2/SDL.h>
+
+// Frames are queued by the GUI thread and encoded by a background thread,
+// to a PNG sequence or, if path ends in ".y4m", a single Y4M stream. When
+// the encoder falls behind, frames are dropped rather than waited for.
+//
+// A path containing a printf-style integer conversion (e.g. "cap/%06d.png")
+// names each PNG; any other path is a directory of frameNNNNNN.png files.
+// Either way, the directory must already exist.
+//
+// The GUI hands over one frame in every, so frames come at fps / every a
+// second, which is what a Y4M stream records as its rate.
+void capture_open(const char *path, int w, int h, int fps, int every, int depth);
+
+// Copies s, which must be w x h, into the queue. Never blocks.
+void capture_frame(SDL_Surface *s);
+
+// Encodes whatever is still queued, then stops the encoder.
+void capture_close(unsigned long *written, unsigned long *dropped);
+
+#endif
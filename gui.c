@@ -0,0 +1,657 @@
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include "capture.h"
+#include "gui.h"
+#include "perf.h"
+#include "trace.h"
+
+//////// BOARD GEOMETRY ////////
+
+struct board_switch switches[N_SW] = {
+#define sw_x(idx) lin_scale(84, 567, 18, idx)
+	{17, sw_x( 0), 604, OFF},
+	{16, sw_x( 1), 604, OFF},
+	{15, sw_x( 2), 604, OFF},
+	{14, sw_x( 3), 604, OFF},
+	{13, sw_x( 4), 604, OFF},
+	{12, sw_x( 5), 604, OFF},
+	{11, sw_x( 6), 604, OFF},
+	{10, sw_x( 7), 604, OFF},
+	{ 9, sw_x( 8), 604, OFF},
+	{ 8, sw_x( 9), 604, OFF},
+	{ 7, sw_x(10), 604, OFF},
+	{ 6, sw_x(11), 604, OFF},
+	{ 5, sw_x(12), 604, OFF},
+	{ 4, sw_x(13), 604, OFF},
+	{ 3, sw_x(14), 604, OFF},
+	{ 2, sw_x(15), 604, OFF},
+	{ 1, sw_x(16), 604, OFF},
+	{ 0, sw_x(17), 604, OFF},
+#undef sw_x
+};
+
+struct board_led red_leds[N_LED] = {
+#define led_x(idx) lin_scale(88, 567, 18, idx)
+	{17, led_x( 0), 561, OFF},
+	{16, led_x( 1), 561, OFF},
+	{15, led_x( 2), 561, OFF},
+	{14, led_x( 3), 561, OFF},
+	{13, led_x( 4), 561, OFF},
+	{12, led_x( 5), 561, OFF},
+	{11, led_x( 6), 561, OFF},
+	{10, led_x( 7), 561, OFF},
+	{ 9, led_x( 8), 561, OFF},
+	{ 8, led_x( 9), 561, OFF},
+	{ 7, led_x(10), 561, OFF},
+	{ 6, led_x(11), 561, OFF},
+	{ 5, led_x(12), 561, OFF},
+	{ 4, led_x(13), 561, OFF},
+	{ 3, led_x(14), 561, OFF},
+	{ 2, led_x(15), 561, OFF},
+	{ 1, led_x(16), 561, OFF},
+	{ 0, led_x(17), 561, OFF},
+#undef led_x
+};
+
+struct board_button buttons[N_BTN] = {
+	{SDLK_q, 3, lin_scale(624, 791, 4, 0), 606, UP},
+	{SDLK_w, 2, lin_scale(624, 791, 4, 1), 606, UP},
+	{SDLK_e, 1, lin_scale(624, 791, 4, 2), 606, UP},
+	{SDLK_r, 0, lin_scale(624, 791, 4, 3), 606, UP},
+};
+
+//////// GUI ////////
+
+// The GUI thread owns the SDL windows and event loop and redraws at a fixed
+// rate (+DE2_fps), however often the simulator hands it LED states. Every
+// board gets a view: its own window, or offscreen surface when headless,
+// and its own copy of the switch, LED & button states.
+
+static struct gui_config cfg;
+
+static SDL_Thread *gui_thread;
+static SDL_atomic_t gui_quit; // window closed; the simulator should finish
+static SDL_atomic_t gui_done; // simulation over; the GUI thread should exit
+
+// Every sprite lives in a single atlas in the window surface's pixel format:
+// the board background at the top, then one tile per sprite state, each
+// already composited over the patch of board it covers. Drawing is thus an
+// opaque same-format copy, with no conversion or alpha blending per frame.
+// All views share it.
+static SDL_Surface *atlas;
+static SDL_Surface *board_img; // DE2.png, until the atlas is built
+
+// Where a sprite goes on screen and where its tiles are in the atlas,
+// indexed by state. An LED's "off" tile is just the board background.
+struct tile {
+	SDL_Rect dst;
+	SDL_Rect src[2];
+};
+
+static SDL_Rect board_rect;
+static struct tile led_tiles[N_LED];
+static struct tile switch_tiles[N_SW];
+static struct tile button_tiles[N_BTN];
+
+struct view {
+	struct board *board;
+	SDL_Window *window;  // NULL when headless
+	SDL_Surface *screen; // the window surface, or an offscreen one
+
+	struct board_switch switches[N_SW];
+	struct board_led leds[N_LED];
+	struct board_button buttons[N_BTN];
+	int seen; // LED hand-offs seen so far
+
+	// Cleared when the window contents are lost (first frame, expose events).
+	int drawn;
+
+	// State each sprite was last drawn with; -1 forces a redraw.
+	int drawn_leds[N_LED];
+	int drawn_switches[N_SW];
+	int drawn_buttons[N_BTN];
+
+	// At most one dirty rect per sprite per frame.
+	SDL_Rect dirty[N_LED + N_SW + N_BTN];
+	int ndirty;
+};
+
+static struct view views[MAX_BOARDS];
+static int nviews;
+
+// The first board is captured (+DE2_capture) once its view exists.
+static int capturing;
+
+// The GUI only shows a change once it is queued for the simulator.
+static void
+handle_button(struct view *v, struct board_button *b, int updown)
+{
+	if (b->state != updown && board_push_input(v->board, INPUT_BUTTON, b->vecidx, updown))
+		b->state = updown;
+}
+
+static void
+handle_switch(struct view *v, struct board_switch *sw)
+{
+	if (board_push_input(v->board, INPUT_SWITCH, sw->vecidx, !sw->state))
+		sw->state = !sw->state;
+}
+
+static struct board_switch *
+find_switch(struct view *v, int x, int y)
+{
+	size_t i;
+	for (i = 0; i < N_SW; i++)
+		if (abs(v->switches[i].x - x) < 10 &&
+		    abs(v->switches[i].y - y) < 20)
+			return &v->switches[i];
+	return NULL;
+}
+
+static struct board_button *
+find_button(struct view *v, SDL_Keycode k)
+{
+	size_t i;
+	for (i = 0; i < N_BTN; i++)
+		if (v->buttons[i].sym == k)
+			return &v->buttons[i];
+	return NULL;
+}
+
+static struct view *
+find_view(Uint32 window_id)
+{
+	int i;
+	for (i = 0; i < nviews; i++)
+		if (SDL_GetWindowID(views[i].window) == window_id)
+			return &views[i];
+	return NULL;
+}
+
+// Keys go to whichever board's window has the focus.
+static void
+handle_input(void)
+{
+	SDL_Event e;
+	struct view *v;
+
+	while (SDL_PollEvent(&e)) {
+		switch (e.type) {
+		case SDL_MOUSEBUTTONDOWN: {
+			struct board_switch *sw;
+			if ((v = find_view(e.button.windowID)) == NULL)
+				break;
+			if ((sw = find_switch(v, e.button.x, e.button.y)) != NULL)
+				handle_switch(v, sw);
+			break;
+		}
+
+		case SDL_KEYDOWN:
+		case SDL_KEYUP: {
+			struct board_button *b;
+			if ((v = find_view(e.key.windowID)) == NULL)
+				break;
+			if ((b = find_button(v, e.key.keysym.sym)) != NULL)
+				handle_button(v, b, e.type == SDL_KEYDOWN ? DOWN : UP);
+			break;
+		}
+
+		case SDL_WINDOWEVENT:
+			if (e.window.event == SDL_WINDOWEVENT_EXPOSED &&
+			    (v = find_view(e.window.windowID)) != NULL)
+				v->drawn = 0;
+			// Closing any board's window ends the simulation.
+			if (e.window.event == SDL_WINDOWEVENT_CLOSE)
+				SDL_AtomicSet(&gui_quit, 1);
+			break;
+
+		case SDL_QUIT:
+			SDL_AtomicSet(&gui_quit, 1);
+			break;
+		}
+	}
+}
+
+static SDL_Surface *
+xload_img(const char *path)
+{
+	SDL_Surface *s;
+	s = IMG_Load(path);
+	if (s == NULL)
+		err(1, "IMG_Load: %s", IMG_GetError());
+	return s;
+}
+
+static SDL_Rect
+centered_rect(int x, int y, int w, int h)
+{
+	SDL_Rect r;
+	r.w = w;
+	r.h = h;
+	r.x = x - w/2;
+	r.y = y - h/2;
+	return r;
+}
+
+// Packs tiles in rows below the board background, left to right.
+struct atlas_packer {
+	int x, y;
+	int row_h;
+};
+
+static SDL_Rect
+atlas_alloc(struct atlas_packer *p, int w, int h)
+{
+	SDL_Rect r;
+
+	if (p->x + w > board_rect.w) {
+		p->x = 0;
+		p->y += p->row_h;
+		p->row_h = 0;
+	}
+
+	r.x = p->x;
+	r.y = p->y;
+	r.w = w;
+	r.h = h;
+
+	p->x += w;
+	p->row_h = SDL_max(p->row_h, h);
+	return r;
+}
+
+static void
+xblit(SDL_Surface *src, SDL_Rect *sr, SDL_Surface *dst, SDL_Rect dr)
+{
+	PERF_BEGIN(PERF_BLIT);
+	if (SDL_BlitSurface(src, sr, dst, &dr) < 0)
+		err(1, "SDL_BlitSurface: %s", SDL_GetError());
+	PERF_END(PERF_BLIT);
+}
+
+// Composites sprite, centered, over the board patch under t->dst into the
+// atlas at t->src[state].
+static void
+atlas_compose(SDL_Surface *board, SDL_Surface *sprite, struct tile *t, int state)
+{
+	SDL_Rect bg = t->dst;
+	SDL_Rect at = t->src[state];
+
+	xblit(board, &bg, atlas, at);
+
+	at.x += (t->dst.w - sprite->w) / 2;
+	at.y += (t->dst.h - sprite->h) / 2;
+	xblit(sprite, NULL, atlas, at);
+}
+
+static void
+atlas_build(SDL_Surface *board, const SDL_PixelFormat *fmt)
+{
+	SDL_Surface *led = xload_img("led.png");
+	SDL_Surface *zero = xload_img("0.png");
+	SDL_Surface *one = xload_img("1.png");
+	struct atlas_packer p;
+	size_t i;
+
+	// 0.png and 1.png differ in size, so an indicator's tiles cover both.
+	int ind_w = SDL_max(zero->w, one->w);
+	int ind_h = SDL_max(zero->h, one->h);
+
+	// Lay out every tile first to learn how tall the atlas must be.
+	p.x = 0;
+	p.y = board->h;
+	p.row_h = 0;
+
+	for (i = 0; i < N_LED; i++) {
+		struct tile *t = &led_tiles[i];
+		t->dst = centered_rect(red_leds[i].x, red_leds[i].y, led->w, led->h);
+		t->src[OFF] = t->dst;
+		t->src[ON] = atlas_alloc(&p, led->w, led->h);
+	}
+
+	for (i = 0; i < N_SW; i++) {
+		struct tile *t = &switch_tiles[i];
+		t->dst = centered_rect(switches[i].x, switches[i].y, ind_w, ind_h);
+		t->src[0] = atlas_alloc(&p, ind_w, ind_h);
+		t->src[1] = atlas_alloc(&p, ind_w, ind_h);
+	}
+
+	for (i = 0; i < N_BTN; i++) {
+		struct tile *t = &button_tiles[i];
+		t->dst = centered_rect(buttons[i].x, buttons[i].y, ind_w, ind_h);
+		t->src[0] = atlas_alloc(&p, ind_w, ind_h);
+		t->src[1] = atlas_alloc(&p, ind_w, ind_h);
+	}
+
+	atlas = SDL_CreateRGBSurfaceWithFormat(0, board->w, p.y + p.row_h,
+	    fmt->BitsPerPixel, fmt->format);
+	if (atlas == NULL)
+		err(1, "SDL_CreateRGBSurfaceWithFormat: %s", SDL_GetError());
+
+	xblit(board, NULL, atlas, board_rect);
+
+	for (i = 0; i < N_LED; i++)
+		atlas_compose(board, led, &led_tiles[i], ON);
+
+	for (i = 0; i < N_SW; i++) {
+		atlas_compose(board, zero, &switch_tiles[i], 0);
+		atlas_compose(board, one, &switch_tiles[i], 1);
+	}
+
+	for (i = 0; i < N_BTN; i++) {
+		atlas_compose(board, zero, &button_tiles[i], 0);
+		atlas_compose(board, one, &button_tiles[i], 1);
+	}
+
+	// Tiles are opaque, so copies out of the atlas never need blending.
+	SDL_SetSurfaceBlendMode(atlas, SDL_BLENDMODE_NONE);
+
+	SDL_FreeSurface(led);
+	SDL_FreeSurface(zero);
+	SDL_FreeSurface(one);
+}
+
+// Headless, the GUI thread only runs to feed frame capture, and draws into
+// offscreen surfaces without initializing SDL video.
+static void
+gui_setup(void)
+{
+	int flags = IMG_INIT_PNG;
+	if ((IMG_Init(flags) & flags) != flags)
+		err(1, "IMG_Init: %s", IMG_GetError());
+
+	board_img = xload_img("DE2.png");
+	board_rect.x = board_rect.y = 0;
+	board_rect.w = board_img->w;
+	board_rect.h = board_img->h;
+
+	if (!cfg.headless && SDL_Init(SDL_INIT_VIDEO) == -1)
+		err(1, "SDL_Init: %s", SDL_GetError());
+}
+
+static void
+view_open(struct view *v, struct board *b)
+{
+	char title[32];
+	int i = board_index(b);
+
+	v->board = b;
+	memcpy(v->switches, switches, sizeof(switches));
+	memcpy(v->leds, red_leds, sizeof(red_leds));
+	memcpy(v->buttons, buttons, sizeof(buttons));
+
+	if (cfg.headless) {
+		v->screen = SDL_CreateRGBSurfaceWithFormat(0, board_rect.w, board_rect.h, 32, SDL_PIXELFORMAT_ARGB8888);
+		if (v->screen == NULL)
+			err(1, "SDL_CreateRGBSurfaceWithFormat: %s", SDL_GetError());
+	} else {
+		if (i == 0)
+			snprintf(title, sizeof(title), "board");
+		else
+			snprintf(title, sizeof(title), "board %d", i);
+
+		v->window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, board_rect.w, board_rect.h, SDL_WINDOW_SHOWN);
+		if (v->window == NULL)
+			err(1, "SDL_CreateWindow: %s", SDL_GetError());
+
+		v->screen = SDL_GetWindowSurface(v->window);
+		if (v->screen == NULL)
+			err(1, "SDL_GetWindowSurface: %s", SDL_GetError());
+	}
+
+	if (atlas == NULL) {
+		atlas_build(board_img, v->screen->format);
+		SDL_FreeSurface(board_img);
+		board_img = NULL;
+	}
+}
+
+static void
+draw_tile(struct view *v, const struct tile *t, int state)
+{
+	SDL_Rect sr = t->src[state != 0];
+
+	xblit(atlas, &sr, v->screen, t->dst);
+	v->dirty[v->ndirty++] = t->dst;
+}
+
+// A partly lit LED is its "on" tile blended over its "off" tile.
+static void
+draw_led(struct view *v, const struct tile *t, int brightness)
+{
+	SDL_Rect sr = t->src[ON];
+
+	if (brightness == OFF || brightness == LED_FULL) {
+		draw_tile(v, t, brightness != OFF);
+		return;
+	}
+
+	draw_tile(v, t, OFF);
+
+	SDL_SetSurfaceBlendMode(atlas, SDL_BLENDMODE_BLEND);
+	SDL_SetSurfaceAlphaMod(atlas, brightness * 255 / LED_FULL);
+	xblit(atlas, &sr, v->screen, t->dst);
+	SDL_SetSurfaceAlphaMod(atlas, 255);
+	SDL_SetSurfaceBlendMode(atlas, SDL_BLENDMODE_NONE);
+}
+
+static void
+draw_leds(struct view *v)
+{
+	size_t i;
+	for (i = 0; i < N_LED; i++) {
+		if (v->leds[i].state == v->drawn_leds[i])
+			continue;
+		draw_led(v, &led_tiles[i], v->leds[i].state);
+		v->drawn_leds[i] = v->leds[i].state;
+	}
+}
+
+static void
+draw_input_states(struct view *v)
+{
+	size_t i;
+
+	for (i = 0; i < N_BTN; i++) {
+		if (v->buttons[i].state == v->drawn_buttons[i])
+			continue;
+		draw_tile(v, &button_tiles[i], v->buttons[i].state);
+		v->drawn_buttons[i] = v->buttons[i].state;
+	}
+
+	for (i = 0; i < N_SW; i++) {
+		if (v->switches[i].state == v->drawn_switches[i])
+			continue;
+		draw_tile(v, &switch_tiles[i], v->switches[i].state);
+		v->drawn_switches[i] = v->switches[i].state;
+	}
+}
+
+// Only sprites whose state changed since the last frame are redrawn and
+// presented; a frame in which nothing changed costs a few compares.
+static void
+render(struct view *v)
+{
+	int full = !v->drawn;
+
+	if (full) {
+		xblit(atlas, &board_rect, v->screen, board_rect);
+
+		memset(v->drawn_leds, -1, sizeof(v->drawn_leds));
+		memset(v->drawn_switches, -1, sizeof(v->drawn_switches));
+		memset(v->drawn_buttons, -1, sizeof(v->drawn_buttons));
+		v->drawn = 1;
+	}
+
+	v->ndirty = 0;
+	draw_leds(v);
+	draw_input_states(v);
+
+	if (v->window == NULL || (!full && v->ndirty == 0))
+		return;
+
+	PERF_BEGIN(PERF_PRESENT);
+	if (full) {
+		if (SDL_UpdateWindowSurface(v->window) < 0)
+			err(1, "SDL_UpdateWindowSurface: %s", SDL_GetError());
+	} else {
+		if (SDL_UpdateWindowSurfaceRects(v->window, v->dirty, v->ndirty) < 0)
+			err(1, "SDL_UpdateWindowSurfaceRects: %s", SDL_GetError());
+	}
+	PERF_END(PERF_PRESENT);
+}
+
+static void
+view_update(struct view *v)
+{
+	struct board_snapshot snap;
+	size_t i;
+
+	if (board_fetch_leds(v->board, &snap, &v->seen)) {
+		for (i = 0; i < N_LED; i++)
+			v->leds[i].state = snap.leds[i];
+		if (snap.show_inputs) {
+			for (i = 0; i < N_SW; i++)
+				v->switches[i].state = vec_bit(snap.inputs.switches, v->switches[i].vecidx);
+			for (i = 0; i < N_BTN; i++)
+				v->buttons[i].state = vec_bit(snap.inputs.buttons, v->buttons[i].vecidx);
+		}
+	}
+
+	PERF_BEGIN(PERF_RENDER);
+	render(v);
+	PERF_END(PERF_RENDER);
+}
+
+void
+gui_pack_inputs(struct board_inputs *in)
+{
+	size_t i;
+
+	for (i = 0; i < N_SW; i++)
+		vec_set_bit(in->switches, switches[i].vecidx, switches[i].state);
+	for (i = 0; i < N_BTN; i++)
+		vec_set_bit(in->buttons, buttons[i].vecidx, buttons[i].state);
+}
+
+// One GUI frame: new views, input, redraws and capture.
+static void
+gui_frame(void)
+{
+	static unsigned long frame;
+	int i;
+
+	// Boards added since the last frame get their views now.
+	for (i = board_count(); nviews < i; nviews++)
+		view_open(&views[nviews], board_get(nviews));
+
+	if (cfg.capture_path != NULL && !capturing && nviews > 0) {
+		capture_open(cfg.capture_path, views[0].screen->w, views[0].screen->h, cfg.fps, cfg.capture_every, cfg.capture_depth);
+		capturing = 1;
+	}
+
+	if (!cfg.headless) {
+		PERF_BEGIN(PERF_HANDLE_INPUT);
+		handle_input();
+		PERF_END(PERF_HANDLE_INPUT);
+	}
+
+	for (i = 0; i < nviews; i++)
+		view_update(&views[i]);
+
+	// Every GUI frame counts, changed or not, to keep a steady frame rate.
+	if (capturing && frame++ % cfg.capture_every == 0)
+		capture_frame(views[0].screen);
+}
+
+#if GUI_THREADED
+
+static int
+gui_main(void *arg)
+{
+	trace_thread_name("GUI");
+	gui_setup();
+
+	while (!SDL_AtomicGet(&gui_done)) {
+		Uint32 deadline = SDL_GetTicks() + 1000 / cfg.fps;
+
+		gui_frame();
+
+		Sint32 left = (Sint32)(deadline - SDL_GetTicks());
+		if (left > 0)
+			SDL_Delay(left);
+	}
+
+	return 0;
+}
+
+void
+gui_start(const struct gui_config *c)
+{
+	cfg = *c;
+
+	gui_thread = SDL_CreateThread(gui_main, "DE2 GUI", NULL);
+	if (gui_thread == NULL)
+		err(1, "SDL_CreateThread: %s", SDL_GetError());
+}
+
+void
+gui_pump(void)
+{
+}
+
+#else
+
+static Uint32 next_frame;
+
+void
+gui_start(const struct gui_config *c)
+{
+	cfg = *c;
+	gui_setup();
+}
+
+// Frames are due every 1/fps seconds of wall time; the simulator never
+// waits for one.
+void
+gui_pump(void)
+{
+	Uint32 now = SDL_GetTicks();
+
+	if ((Sint32)(now - next_frame) < 0)
+		return;
+	next_frame = now + 1000 / cfg.fps;
+	gui_frame();
+}
+
+#endif
+
+void
+gui_stop(void)
+{
+	unsigned long written, dropped;
+
+	if (gui_thread != NULL) {
+		SDL_AtomicSet(&gui_done, 1);
+		SDL_WaitThread(gui_thread, NULL);
+		gui_thread = NULL;
+	}
+
+	if (capturing) {
+		capture_close(&written, &dropped);
+		printf("DE2: captured %lu frames to %s, dropped %lu\n", written, cfg.capture_path, dropped);
+		fflush(stdout);
+	}
+}
+
+// Once a window is closed, the backend should end the simulation.
+int
+gui_quit_requested(void)
+{
+	return SDL_AtomicGet(&gui_quit);
+}
@@ -0,0 +1,96 @@
+#ifndef __DE2_GUI__
+#define __DE2_GUI__
+
+#include <SDL2/SDL.h>
+
+#include "board.h"
+
+// The GUI thread, private to the board core: board.c starts and stops it,
+// and otherwise the two only meet through the LED exchange and the input
+// queue, both in board.c.
+
+#define lin_scale(start, stop, count, idx) (((stop)-(start))*(idx)/((count)-1)+(start))
+
+#define ON   (1)
+#define OFF  (0)
+
+#define UP   (1)
+#define DOWN (0)
+
+struct board_switch {
+	int vecidx;
+	int x;
+	int y;
+	int state;
+};
+
+// An LED's state is its brightness, from OFF to LED_FULL.
+struct board_led {
+	int vecidx;
+	int x;
+	int y;
+	int state;
+};
+
+struct board_button {
+	SDL_Keycode sym;
+	int vecidx;
+	int x;
+	int y;
+	int state;
+};
+
+// The geometry tables; .state fields belong to the GUI thread.
+extern struct board_switch switches[N_SW];
+extern struct board_led red_leds[N_LED];
+extern struct board_button buttons[N_BTN];
+
+// Switch & button states as the design sees them, packed by vecidx.
+struct board_inputs {
+	uint32_t switches[VEC_WORDS(N_SW)];
+	uint32_t buttons[VEC_WORDS(N_BTN)];
+};
+
+// LED brightnesses, as handed from the simulator to the GUI, and, once
+// set by board_show_inputs or a stimulus script, the switch & button
+// positions to draw.
+struct board_snapshot {
+	int leds[N_LED];
+	int show_inputs;
+	struct board_inputs inputs;
+};
+
+struct gui_config {
+	int fps;
+	int headless;
+	const char *capture_path; // NULL for no capture
+	int capture_every;
+	int capture_depth;
+};
+
+// SDL on macOS only works from the main thread, which is the simulator's,
+// so there the GUI has no thread of its own: gui_start sets it up in place,
+// and the simulator runs a frame in gui_pump whenever one is due. Elsewhere
+// gui_pump does nothing.
+#ifdef __APPLE__
+#define GUI_THREADED (0)
+#else
+#define GUI_THREADED (1)
+#endif
+
+void gui_start(const struct gui_config *cfg);
+void gui_pump(void);
+void gui_stop(void);
+int gui_quit_requested(void);
+
+// Packs the switch & button positions the GUI starts out with.
+void gui_pack_inputs(struct board_inputs *in);
+
+// Implemented in board.c, for the GUI thread. board_count only ever grows.
+int board_count(void);
+struct board *board_get(int i);
+int board_index(const struct board *b);
+int board_fetch_leds(struct board *b, struct board_snapshot *snap, int *seen);
+int board_push_input(struct board *b, enum input_kind kind, int index, int state);
+
+#endif
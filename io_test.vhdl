@@ -0,0 +1,23 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+-- The README's io_test, in VHDL, for board_ghdl.sh: each LED shows its
+-- switch, masked by the buttons while they are released.
+entity io_test is
+	port(
+		clk		: in std_logic;
+		leds		: out std_logic_vector(17 downto 0);
+		switches	: in std_logic_vector(17 downto 0);
+		buttons		: in std_logic_vector(3 downto 0)
+	);
+end entity io_test;
+
+architecture rtl of io_test is
+begin
+	process(clk)
+	begin
+		if rising_edge(clk) then
+			leds <= switches and not (buttons(1 downto 0) & buttons & buttons & buttons & buttons);
+		end if;
+	end process;
+end architecture rtl;
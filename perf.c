@@ -0,0 +1,117 @@
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "perf.h"
+
+#ifdef DE2_PERF
+
+struct perf_timer perf_timers[PERF_N];
+
+static const char *perf_names[PERF_N] = {
+	[PERF_LEDS] = "$DE2_leds",
+	[PERF_LEDS_CHANGED] = "LED value change",
+	[PERF_SWITCHES] = "$DE2_switches",
+	[PERF_BUTTONS] = "$DE2_buttons",
+	[PERF_RENDER_TF] = "$DE2_render",
+	[PERF_HANDLE_INPUT_TF] = "$DE2_handle_input",
+	[PERF_SYNC] = "$DE2_sync",
+	[PERF_SERVICE] = "$DE2_attach service",
+	[PERF_SERVICE_INPUT] = "$DE2_attach input",
+	[PERF_RENDER] = "render()",
+	[PERF_HANDLE_INPUT] = "handle_input()",
+	[PERF_BLIT] = "blit",
+	[PERF_PRESENT] = "present",
+};
+
+const char *
+perf_name(enum perf_timer_id id)
+{
+	return perf_names[id];
+}
+
+static uint64_t perf_start;
+static volatile sig_atomic_t perf_requested;
+
+uint64_t
+perf_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+perf_signal(int sig)
+{
+	perf_requested = 1;
+}
+
+void
+perf_init(void)
+{
+	perf_start = perf_now();
+	signal(SIGUSR1, perf_signal);
+}
+
+// The largest value falling in bucket b.
+static uint64_t
+perf_bucket_max(int b)
+{
+	int e = b / PERF_SUB + PERF_SUB_BITS - 1;
+
+	if (b < PERF_SUB)
+		return b;
+	return ((uint64_t)(PERF_SUB + b % PERF_SUB + 1) << (e - PERF_SUB_BITS)) - 1;
+}
+
+// The q-quantile of t's latencies, to within its bucket, in ns. The
+// histogram may have moved on since calls was read, hence the clamping.
+static uint64_t
+perf_quantile(const struct perf_timer *t, uint64_t calls, double q)
+{
+	uint64_t rank = (uint64_t)(q * calls), seen = 0;
+	int b;
+
+	for (b = 0; b < PERF_BUCKETS; b++) {
+		seen += t->hist[b];
+		if (seen > rank)
+			return perf_bucket_max(b) < t->max_ns ? perf_bucket_max(b) : t->max_ns;
+	}
+	return t->max_ns;
+}
+
+void
+perf_report(double sim_seconds)
+{
+	double wall = (perf_now() - perf_start) / 1e9;
+	int i;
+
+	printf("DE2: perf: %.3f s wall, %g s sim (%g sim s per wall s)\n",
+	    wall, sim_seconds, wall > 0 ? sim_seconds / wall : 0);
+	printf("DE2: perf: %-20s %12s %12s %10s %10s %10s %10s %10s\n", "",
+	    "calls", "total ms", "avg us", "p50 us", "p90 us", "p99 us", "max us");
+	for (i = 0; i < PERF_N; i++) {
+		struct perf_timer *t = &perf_timers[i];
+		uint64_t calls = t->calls;
+
+		if (calls == 0)
+			continue;
+		printf("DE2: perf: %-20s %12llu %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", perf_names[i],
+		    (unsigned long long)calls, t->ns / 1e6, t->ns / 1e3 / calls,
+		    perf_quantile(t, calls, 0.50) / 1e3, perf_quantile(t, calls, 0.90) / 1e3,
+		    perf_quantile(t, calls, 0.99) / 1e3, t->max_ns / 1e3);
+	}
+	fflush(stdout);
+}
+
+void
+perf_poll(double (*sim_seconds)(void))
+{
+	if (!perf_requested)
+		return;
+	perf_requested = 0;
+	perf_report(sim_seconds());
+}
+
+#endif
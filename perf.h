@@ -0,0 +1,114 @@
+#ifndef __DE2_PERF__
+#define __DE2_PERF__
+
+#include <stdint.h>
+
+// Performance counters: calls, cumulative and maximum wall time, and a
+// latency histogram, for each of the hot paths below. Built only with
+// -DDE2_PERF (make PERF=1); otherwise every PERF_* macro compiles to
+// nothing. Reported at the end of the simulation, and on SIGUSR1.
+//
+// Each timer is only ever updated by one thread, the simulator's or the
+// GUI's, so recording takes no locks, atomics or allocation, and is cheap
+// enough to leave on; a report made while the other thread runs may be off
+// by a call.
+enum perf_timer_id {
+	// simulator thread
+	PERF_LEDS,
+	PERF_LEDS_CHANGED,
+	PERF_SWITCHES,
+	PERF_BUTTONS,
+	PERF_RENDER_TF,
+	PERF_HANDLE_INPUT_TF,
+	PERF_SYNC,
+	PERF_SERVICE,
+	PERF_SERVICE_INPUT,
+	// GUI thread
+	PERF_RENDER,
+	PERF_HANDLE_INPUT,
+	PERF_BLIT,
+	PERF_PRESENT,
+	PERF_N
+};
+
+#ifdef DE2_PERF
+
+// Histogram buckets are log-linear: values below 4 ns get a bucket each,
+// and every power of two above is split into 4, for 25% resolution.
+#define PERF_SUB_BITS (2)
+#define PERF_SUB (1 << PERF_SUB_BITS)
+#define PERF_BUCKETS ((64 - PERF_SUB_BITS + 1) * PERF_SUB)
+
+struct perf_timer {
+	uint64_t calls;
+	uint64_t ns;
+	uint64_t max_ns;
+	uint64_t hist[PERF_BUCKETS];
+};
+
+extern struct perf_timer perf_timers[PERF_N];
+
+uint64_t perf_now(void);
+
+static inline int
+perf_bucket(uint64_t ns)
+{
+	int e;
+
+	if (ns < PERF_SUB)
+		return (int)ns;
+	e = 63 - __builtin_clzll(ns);
+	return (e - PERF_SUB_BITS + 1) * PERF_SUB + (int)((ns >> (e - PERF_SUB_BITS)) & (PERF_SUB - 1));
+}
+
+static inline void
+perf_record(enum perf_timer_id id, uint64_t ns)
+{
+	struct perf_timer *t = &perf_timers[id];
+
+	t->calls++;
+	t->ns += ns;
+	if (ns > t->max_ns)
+		t->max_ns = ns;
+	t->hist[perf_bucket(ns)]++;
+}
+
+// Set while +DE2_trace records every span as well, see trace.h.
+extern int trace_enabled;
+void trace_span(enum perf_timer_id id, uint64_t begin_ns, uint64_t end_ns);
+
+static inline void
+perf_end(enum perf_timer_id id, uint64_t t0)
+{
+	uint64_t t1 = perf_now();
+
+	perf_record(id, t1 - t0);
+	if (trace_enabled)
+		trace_span(id, t0, t1);
+}
+
+#define PERF_BEGIN(id) uint64_t perf_t0_##id = perf_now()
+#define PERF_END(id) perf_end(id, perf_t0_##id)
+
+const char *perf_name(enum perf_timer_id id);
+
+// Installs the SIGUSR1 handler.
+void perf_init(void);
+// Prints every timer, plus how far sim time advanced, in seconds.
+void perf_report(double sim_seconds);
+// Reports if SIGUSR1 arrived since the last call, only then asking
+// sim_seconds how far sim time advanced.
+void perf_poll(double (*sim_seconds)(void));
+
+#else
+
+#define PERF_BEGIN(id)
+#define PERF_END(id)
+
+static inline void perf_init(void) {}
+static inline void perf_report(double sim_seconds) {}
+static inline void perf_poll(double (*sim_seconds)(void)) {}
+
+#endif
+
+#endif
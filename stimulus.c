@@ -0,0 +1,317 @@
+#include <ctype.h>
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "gui.h"
+#include "stimulus.h"
+
+struct script {
+	struct stimulus_event *ev;
+	size_t n, cap;
+	size_t next;
+};
+
+static struct script scripts[MAX_BOARDS];
+
+static void
+add(int board, uint64_t t, enum input_kind kind, int index, int state)
+{
+	struct script *s = &scripts[board];
+
+	if (s->n == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 64;
+		if ((s->ev = realloc(s->ev, s->cap * sizeof(*s->ev))) == NULL)
+			err(1, "realloc");
+	}
+	s->ev[s->n].t = t;
+	s->ev[s->n].kind = kind;
+	s->ev[s->n].index = index;
+	s->ev[s->n].state = state;
+	s->n++;
+}
+
+// Returns -1 if word is none of the given spellings for off & on.
+static int
+parse_state(const char *word, const char *off, const char *on)
+{
+	if (word == NULL)
+		return -1;
+	if (strcasecmp(word, off) == 0 || strcmp(word, "0") == 0)
+		return 0;
+	if (strcasecmp(word, on) == 0 || strcmp(word, "1") == 0)
+		return 1;
+	return -1;
+}
+
+static int
+parse_index(const char *word, int n)
+{
+	char *end;
+	long i;
+
+	if (word == NULL)
+		return -1;
+	i = strtol(word, &end, 10);
+	return end == word || *end != '\0' || i < 0 || i >= n ? -1 : (int)i;
+}
+
+static int
+key_button(const char *word)
+{
+	size_t i;
+
+	if (word == NULL || strlen(word) != 1)
+		return -1;
+	for (i = 0; i < N_BTN; i++)
+		if (buttons[i].sym == (SDL_Keycode)tolower((unsigned char)word[0]))
+			return buttons[i].vecidx;
+	return -1;
+}
+
+// Parses one line into board's script; returns 0 if it is malformed.
+static int
+parse_line(char *line, int *board, uint64_t *t)
+{
+	char *word[5];
+	int n, index, state, i;
+
+	for (n = 0; n < 5 && (word[n] = strtok(n ? NULL : line, " \t\r\n")) != NULL; n++)
+		;
+	if (n == 0)
+		return 1;
+
+	if (strcmp(word[0], "board") == 0) {
+		return n == 2 && (*board = parse_index(word[1], MAX_BOARDS)) >= 0;
+	}
+
+	if (n != 4)
+		return 0;
+	if (word[0][0] == '+') {
+		uint64_t dt = board_parse_time(word[0] + 1);
+
+		if (dt == 0 && word[0][1] != '0')
+			return 0;
+		*t += dt;
+	} else {
+		uint64_t at = board_parse_time(word[0]);
+
+		if (at == 0 && word[0][0] != '0')
+			return 0;
+		*t = at;
+	}
+
+	if (strcmp(word[1], "sw") == 0 && strcmp(word[2], "all") == 0) {
+		unsigned long bits;
+		char *end;
+
+		bits = strtoul(word[3], &end, 0);
+		if (end == word[3] || *end != '\0')
+			return 0;
+		for (i = 0; i < N_SW; i++)
+			add(*board, *t, INPUT_SWITCH, i, (bits >> i) & 1);
+		return 1;
+	}
+
+	if (strcmp(word[1], "sw") == 0) {
+		index = parse_index(word[2], N_SW);
+		state = parse_state(word[3], "off", "on");
+		if (index < 0 || state < 0)
+			return 0;
+		add(*board, *t, INPUT_SWITCH, index, state);
+		return 1;
+	}
+
+	if (strcmp(word[1], "btn") == 0 || strcmp(word[1], "key") == 0) {
+		index = word[1][0] == 'b' ? parse_index(word[2], N_BTN) : key_button(word[2]);
+		state = parse_state(word[3], "down", "up");
+		if (index < 0 || state < 0)
+			return 0;
+		add(*board, *t, INPUT_BUTTON, index, state == 1 ? UP : DOWN);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Sorts by time, keeping lines in file order among equal times. Scripts
+// are mostly in order already, which insertion sort makes cheap.
+static void
+sort_script(struct script *s)
+{
+	size_t i, j;
+
+	for (i = 1; i < s->n; i++) {
+		struct stimulus_event ev = s->ev[i];
+
+		for (j = i; j > 0 && s->ev[j - 1].t > ev.t; j--)
+			s->ev[j] = s->ev[j - 1];
+		s->ev[j] = ev;
+	}
+}
+
+void
+stimulus_load(const char *path)
+{
+	char line[256];
+	uint64_t t = 0;
+	int board = 0, lineno = 0, i;
+	size_t n = 0;
+	FILE *f;
+
+	if ((f = fopen(path, "r")) == NULL)
+		err(1, "+DE2_stimulus: %s", path);
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char *hash = strchr(line, '#');
+
+		lineno++;
+		if (hash != NULL)
+			*hash = '\0';
+		if (!parse_line(line, &board, &t))
+			errx(1, "%s:%d: expected e.g. \"10us sw 3 on\", \"+5us key q down\" or \"board 1\"", path, lineno);
+	}
+	if (ferror(f))
+		err(1, "+DE2_stimulus: %s", path);
+	fclose(f);
+
+	for (i = 0; i < MAX_BOARDS; i++) {
+		sort_script(&scripts[i]);
+		n += scripts[i].n;
+	}
+
+	printf("DE2: %zu scripted input changes from %s\n", n, path);
+	fflush(stdout);
+}
+
+const struct stimulus_event *
+stimulus_peek(int board)
+{
+	struct script *s = &scripts[board];
+
+	return s->next < s->n ? &s->ev[s->next] : NULL;
+}
+
+void
+stimulus_take(int board)
+{
+	scripts[board].next++;
+}
+
+//////// INPUT LOGS ////////
+
+#define LOG_MAGIC "DE2 input log\n"
+
+static struct {
+	FILE *f;
+	const char *path;
+	uint64_t last;
+	unsigned long n;
+} rec;
+
+static void
+put_varint(FILE *f, uint64_t v)
+{
+	while (v >= 0x80) {
+		putc((int)(v & 0x7f) | 0x80, f);
+		v >>= 7;
+	}
+	putc((int)v, f);
+}
+
+// Returns 0 at the end of the file.
+static int
+get_varint(FILE *f, const char *path, uint64_t *v)
+{
+	int c, shift = 0;
+
+	*v = 0;
+	while ((c = getc(f)) != EOF) {
+		if (shift > 63)
+			break;
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return 1;
+		shift += 7;
+	}
+	if (ferror(f))
+		err(1, "+DE2_replay_input: %s", path);
+	if (shift != 0)
+		errx(1, "+DE2_replay_input: %s is truncated or corrupt", path);
+	return 0;
+}
+
+void
+stimulus_load_log(const char *path, int precision)
+{
+	char magic[sizeof(LOG_MAGIC) - 1];
+	uint64_t t = 0, dt, code;
+	unsigned long n = 0;
+	FILE *f;
+	int i;
+
+	if ((f = fopen(path, "rb")) == NULL)
+		err(1, "+DE2_replay_input: %s", path);
+	if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+	    memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0)
+		errx(1, "+DE2_replay_input: %s is not an input log", path);
+	if ((i = getc(f)) == EOF || (signed char)i != precision)
+		errx(1, "+DE2_replay_input: %s was recorded at a time precision of 1e%d, not 1e%d",
+		    path, i == EOF ? 0 : (signed char)i, precision);
+
+	while (get_varint(f, path, &dt)) {
+		int state, index, kind, board;
+
+		if (!get_varint(f, path, &code))
+			errx(1, "+DE2_replay_input: %s is truncated", path);
+		// The board is range-checked before it is narrowed to an int.
+		if ((code >> 7) >= MAX_BOARDS)
+			errx(1, "+DE2_replay_input: %s is corrupt", path);
+		state = code & 1;
+		index = (code >> 1) & 31;
+		kind = (code >> 6) & 1;
+		board = (int)(code >> 7);
+		if (index >= (kind == INPUT_SWITCH ? N_SW : N_BTN))
+			errx(1, "+DE2_replay_input: %s is corrupt", path);
+
+		t += dt;
+		add(board, t, kind, index, state);
+		n++;
+	}
+	fclose(f);
+
+	printf("DE2: replaying %lu input changes from %s\n", n, path);
+	fflush(stdout);
+}
+
+void
+stimulus_record_open(const char *path, int precision)
+{
+	if ((rec.f = fopen(path, "wb")) == NULL)
+		err(1, "+DE2_record_input: %s", path);
+	rec.path = path;
+
+	fputs(LOG_MAGIC, rec.f);
+	putc((signed char)precision, rec.f);
+}
+
+void
+stimulus_record(uint64_t t, int board, enum input_kind kind, int index, int state)
+{
+	put_varint(rec.f, t - rec.last);
+	put_varint(rec.f, ((uint64_t)(board * 2 + kind) * 32 + index) * 2 + (state != 0));
+	rec.last = t;
+	rec.n++;
+}
+
+void
+stimulus_record_close(void)
+{
+	if (fclose(rec.f) != 0)
+		err(1, "+DE2_record_input: %s", rec.path);
+	printf("DE2: recorded %lu input changes to %s\n", rec.n, rec.path);
+	fflush(stdout);
+}
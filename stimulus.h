@@ -0,0 +1,47 @@
+#ifndef __DE2_STIMULUS__
+#define __DE2_STIMULUS__
+
+#include <stdint.h>
+
+#include "board.h"
+
+// A stimulus script (+DE2_stimulus=path) sets switches & buttons at given
+// sim times, through the same input path as the GUI, so interactive
+// designs can be driven without anyone at the board. One change per line;
+// '#' starts a comment:
+//
+//	board 1             following lines drive board 1 (default 0)
+//	10us sw 3 on        SW[3] on (on/off or 1/0)
+//	+5us key q down     the button on the Q key pressed (down/up)
+//	+1ms btn 3 up       KEY[3] released (down/up or 0/1)
+//	2ms sw all 0x2aaaa  all switches at once
+//
+// A time is absolute, or with a leading '+' relative to the line before,
+// and either carries a unit or is a bare number of sim time units.
+
+struct stimulus_event {
+	uint64_t t;
+	enum input_kind kind;
+	int index; // vecidx
+	int state;
+};
+
+// Must be called after board_init has set the time precision.
+void stimulus_load(const char *path);
+
+// An input log (+DE2_record_input=path) holds every switch & button change
+// made in the window, at the sim time it reached the design, so a session
+// replays exactly (+DE2_replay_input=path) as scripted input. It is binary:
+// a header naming the time precision, then per change a LEB128 varint of
+// the time since the previous change and one of
+// ((board * 2 + kind) * 32 + index) * 2 + state.
+void stimulus_load_log(const char *path, int precision);
+void stimulus_record_open(const char *path, int precision);
+void stimulus_record(uint64_t t, int board, enum input_kind kind, int index, int state);
+void stimulus_record_close(void);
+
+// The board's next event, in time order, or NULL once there is none left.
+const struct stimulus_event *stimulus_peek(int board);
+void stimulus_take(int board);
+
+#endif
@@ -0,0 +1,240 @@
+#include <err.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+#include "trace.h"
+
+#ifdef DE2_PERF
+
+#define TRACE_RING_LEN (1 << 16)
+#define TRACE_MAX_THREADS (8)
+
+struct trace_event {
+	enum perf_timer_id id;
+	uint64_t begin_ns;
+	uint64_t dur_ns;
+	uint64_t sim;
+};
+
+// Single-producer, single-consumer: the owning thread advances tail, the
+// writer advances head.
+struct trace_ring {
+	int tid;
+	const char *name;
+	struct trace_event ev[TRACE_RING_LEN];
+	SDL_atomic_t head;
+	SDL_atomic_t tail;
+	unsigned long dropped; // by the owning thread
+};
+
+int trace_enabled;
+
+static struct {
+	FILE *f;
+	const char *path;
+	uint64_t (*now)(void);
+	double unit;         // seconds per sim time unit
+	SDL_threadID sim_thread;
+	uint64_t sim_last;   // set on the simulator thread, read on others
+	uint64_t wall0;      // ts 0 in the trace
+
+	struct trace_ring *rings[TRACE_MAX_THREADS];
+	SDL_atomic_t nrings;
+
+	SDL_Thread *thread;
+	SDL_atomic_t closing;
+	unsigned long written;
+	int first;
+} tr;
+
+static __thread struct trace_ring *my_ring;
+
+static struct trace_ring *
+ring_get(void)
+{
+	int n;
+
+	if (my_ring != NULL)
+		return my_ring;
+
+	// Threads are few and register once, so a CAS loop for a slot is fine.
+	do {
+		n = SDL_AtomicGet(&tr.nrings);
+		if (n == TRACE_MAX_THREADS)
+			return NULL;
+	} while (!SDL_AtomicCAS(&tr.nrings, n, n + 1));
+
+	my_ring = calloc(1, sizeof(*my_ring));
+	if (my_ring == NULL)
+		err(1, "calloc");
+	my_ring->tid = n + 1;
+	my_ring->name = "simulator";
+	SDL_AtomicSetPtr((void **)&tr.rings[n], my_ring);
+	return my_ring;
+}
+
+void
+trace_thread_name(const char *name)
+{
+	struct trace_ring *r;
+
+	if (trace_enabled && (r = ring_get()) != NULL)
+		r->name = name;
+}
+
+void
+trace_span(enum perf_timer_id id, uint64_t begin_ns, uint64_t end_ns)
+{
+	struct trace_ring *r = ring_get();
+	struct trace_event *ev;
+	int tail, next;
+	uint64_t sim;
+
+	if (r == NULL)
+		return;
+
+	if (SDL_ThreadID() == tr.sim_thread) {
+		sim = tr.now();
+		__atomic_store_n(&tr.sim_last, sim, __ATOMIC_RELAXED);
+	} else {
+		sim = __atomic_load_n(&tr.sim_last, __ATOMIC_RELAXED);
+	}
+
+	tail = SDL_AtomicGet(&r->tail);
+	next = (tail + 1) % TRACE_RING_LEN;
+	if (next == SDL_AtomicGet(&r->head)) {
+		r->dropped++;
+		return;
+	}
+	// SDL_AtomicGet & Set order nothing around them, so the barriers pair
+	// the event's writes here with its reads in drain(), and the writer's
+	// last reads of the slot with its reuse here.
+	SDL_MemoryBarrierAcquire();
+
+	ev = &r->ev[tail];
+	ev->id = id;
+	ev->begin_ns = begin_ns;
+	ev->dur_ns = end_ns - begin_ns;
+	ev->sim = sim;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&r->tail, next);
+}
+
+static void
+write_event(const struct trace_ring *r, const struct trace_event *ev)
+{
+	uint64_t begin = ev->begin_ns > tr.wall0 ? ev->begin_ns - tr.wall0 : 0;
+
+	fprintf(tr.f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"sim_s\":%.12g}}",
+	    tr.first ? "" : ",", perf_name(ev->id), r->tid,
+	    begin / 1e3, ev->dur_ns / 1e3, ev->sim * tr.unit);
+	tr.first = 0;
+	tr.written++;
+}
+
+static void
+drain(void)
+{
+	int i, n = SDL_AtomicGet(&tr.nrings);
+
+	for (i = 0; i < n; i++) {
+		struct trace_ring *r = SDL_AtomicGetPtr((void **)&tr.rings[i]);
+		int head, tail;
+
+		// A slot is claimed before its ring is stored.
+		if (r == NULL)
+			continue;
+
+		head = SDL_AtomicGet(&r->head);
+		tail = SDL_AtomicGet(&r->tail);
+		SDL_MemoryBarrierAcquire(); // see trace_span
+		for (; head != tail; head = (head + 1) % TRACE_RING_LEN)
+			write_event(r, &r->ev[head]);
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&r->head, head);
+	}
+}
+
+static int
+writer_main(void *arg)
+{
+	while (!SDL_AtomicGet(&tr.closing)) {
+		drain();
+		SDL_Delay(10);
+	}
+	drain();
+	return 0;
+}
+
+void
+trace_open(const char *path, uint64_t (*now)(void), int precision)
+{
+	tr.f = fopen(path, "w");
+	if (tr.f == NULL)
+		err(1, "+DE2_trace: %s", path);
+
+	tr.path = path;
+	tr.now = now;
+	tr.unit = pow(10, precision);
+	tr.sim_thread = SDL_ThreadID();
+	tr.wall0 = perf_now();
+	tr.first = 1;
+
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", tr.f);
+
+	tr.thread = SDL_CreateThread(writer_main, "DE2 trace", NULL);
+	if (tr.thread == NULL)
+		err(1, "SDL_CreateThread: %s", SDL_GetError());
+	trace_enabled = 1;
+}
+
+void
+trace_close(void)
+{
+	unsigned long dropped = 0;
+	int i, n;
+
+	if (!trace_enabled)
+		return;
+	trace_enabled = 0;
+
+	SDL_AtomicSet(&tr.closing, 1);
+	SDL_WaitThread(tr.thread, NULL);
+
+	n = SDL_AtomicGet(&tr.nrings);
+	for (i = 0; i < n; i++) {
+		struct trace_ring *r = tr.rings[i];
+
+		if (r == NULL)
+			continue;
+		fprintf(tr.f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		    tr.first ? "" : ",", r->tid, r->name);
+		tr.first = 0;
+		dropped += r->dropped;
+	}
+
+	fputs("\n]}\n", tr.f);
+	if (fclose(tr.f) != 0)
+		err(1, "+DE2_trace: %s", tr.path);
+
+	printf("DE2: traced %lu spans to %s, dropped %lu\n", tr.written, tr.path, dropped);
+	fflush(stdout);
+}
+
+#else
+
+void
+trace_open(const char *path, uint64_t (*now)(void), int precision)
+{
+	errx(1, "+DE2_trace needs a build with performance counters (make PERF=1)");
+}
+
+void
+trace_close(void)
+{
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __DE2_TRACE__
+#define __DE2_TRACE__
+
+#include <stdint.h>
+
+#include "perf.h"
+
+// Trace-event timeline (+DE2_trace=path.json, PERF=1 builds only): every
+// perf timer span becomes a Chrome trace "complete" event, stamped with its
+// wall-clock start and duration and the simulation time it ran at. Open the
+// file in chrome://tracing or Perfetto.
+//
+// Spans go into a ring per thread, written only by that thread and drained
+// by a background writer, so tracing never blocks a hot path; a span that
+// finds its ring full is dropped and counted instead.
+
+// now returns the current simulation time in units of 10^precision
+// seconds; it is only called on the thread that opens the trace. Spans on
+// other threads carry the last simulation time seen there.
+void trace_open(const char *path, uint64_t (*now)(void), int precision);
+void trace_close(void);
+
+#ifdef DE2_PERF
+
+// Names the calling thread in the trace; unnamed threads show as "simulator".
+void trace_thread_name(const char *name);
+
+#else
+
+static inline void trace_thread_name(const char *name) {}
+
+#endif
+
+#endif
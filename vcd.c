@@ -0,0 +1,270 @@
+#include <err.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "board.h"
+#include "vcd.h"
+
+#define VCD_BUF_LEN (1 << 20)
+#define VCD_LINE_MAX (256)
+
+static const struct {
+	const char *name;
+	int width;
+} vcd_vars[VCD_SIGNALS] = {
+	[VCD_LEDS] = { "leds", N_LED },
+	[VCD_SWITCHES] = { "switches", N_SW },
+	[VCD_BUTTONS] = { "buttons", N_BTN },
+};
+
+static struct {
+	FILE *f;
+	const char *path;
+	int precision;
+	uint64_t start;
+	uint64_t last; // time of the last #timestamp
+
+	int declared;  // boards in the header, once written
+	int header;
+	int late_warned;
+	int known[MAX_BOARDS];
+	uint32_t val[MAX_BOARDS][VCD_SIGNALS][VEC_WORDS(VCD_MAX_WIDTH)];
+
+	// buf[cur] is filled by the simulator; buf[!cur] is written out by
+	// the writer thread while pending is set.
+	char *buf[2];
+	size_t len;
+	int cur;
+	int pending;
+	int closing;
+	SDL_mutex *lock;
+	SDL_cond *cond;
+	SDL_Thread *thread;
+
+	unsigned long changes;
+	unsigned long waits;
+} vcd;
+
+static int
+writer_main(void *arg)
+{
+	for (;;) {
+		size_t n;
+		int out;
+
+		SDL_LockMutex(vcd.lock);
+		while (!vcd.pending && !vcd.closing)
+			SDL_CondWait(vcd.cond, vcd.lock);
+		if (!vcd.pending) {
+			SDL_UnlockMutex(vcd.lock);
+			return 0;
+		}
+		n = vcd.pending;
+		out = !vcd.cur;
+		SDL_UnlockMutex(vcd.lock);
+
+		if (fwrite(vcd.buf[out], 1, n, vcd.f) != n)
+			err(1, "+DE2_vcd: %s", vcd.path);
+
+		SDL_LockMutex(vcd.lock);
+		vcd.pending = 0;
+		SDL_CondBroadcast(vcd.cond);
+		SDL_UnlockMutex(vcd.lock);
+	}
+}
+
+// Hands the filled buffer to the writer, waiting for it to finish the
+// previous one first.
+static void
+vcd_flush(void)
+{
+	if (vcd.len == 0)
+		return;
+
+	SDL_LockMutex(vcd.lock);
+	if (vcd.pending)
+		vcd.waits++;
+	while (vcd.pending)
+		SDL_CondWait(vcd.cond, vcd.lock);
+	vcd.cur = !vcd.cur;
+	vcd.pending = vcd.len;
+	SDL_CondBroadcast(vcd.cond);
+	SDL_UnlockMutex(vcd.lock);
+
+	vcd.len = 0;
+}
+
+static void
+vcd_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (vcd.len + VCD_LINE_MAX > VCD_BUF_LEN)
+		vcd_flush();
+
+	va_start(ap, fmt);
+	vcd.len += vsnprintf(vcd.buf[vcd.cur] + vcd.len, VCD_LINE_MAX, fmt, ap);
+	va_end(ap);
+}
+
+static void
+vcd_value(int board, enum vcd_signal sig)
+{
+	char bits[VCD_MAX_WIDTH + 1];
+	int i, width = vcd_vars[sig].width;
+
+	for (i = 0; i < width; i++)
+		bits[i] = vec_bit(vcd.val[board][sig], width - 1 - i) ? '1' : '0';
+	bits[width] = '\0';
+
+	// One printable character per signal identifies it; there are fewer
+	// than 94 of them.
+	vcd_printf("b%s %c\n", bits, '!' + board * VCD_SIGNALS + sig);
+}
+
+static void
+vcd_timestamp(uint64_t now)
+{
+	if (now != vcd.last)
+		vcd_printf("#%llu\n", (unsigned long long)now);
+	vcd.last = now;
+}
+
+// VCD only has 1, 10 & 100 of s, ms, us, ns, ps or fs.
+static void
+vcd_timescale(int precision)
+{
+	static const char *units[] = { "s", "ms", "us", "ns", "ps", "fs" };
+	int u = precision >= 0 ? 0 : (-precision + 2) / 3;
+	int mag = precision + 3 * u;
+
+	if (u > 5 || mag > 2)
+		errx(1, "+DE2_vcd: time precision 1e%d has no VCD timescale", precision);
+	vcd_printf("$timescale %s%s $end\n", mag == 2 ? "100" : mag == 1 ? "10" : "1", units[u]);
+}
+
+static void
+vcd_header(void)
+{
+	int b, s;
+
+	vcd_printf("$version DE2 board simulator $end\n");
+	vcd_timescale(vcd.precision);
+	vcd_printf("$scope module DE2 $end\n");
+	for (b = 0; b < MAX_BOARDS && vcd.known[b]; b++) {
+		vcd_printf("$scope module board%d $end\n", b);
+		for (s = 0; s < VCD_SIGNALS; s++)
+			vcd_printf("$var wire %d %c %s [%d:0] $end\n", vcd_vars[s].width,
+			    '!' + b * VCD_SIGNALS + s, vcd_vars[s].name, vcd_vars[s].width - 1);
+		vcd_printf("$upscope $end\n");
+	}
+	vcd_printf("$upscope $end\n$enddefinitions $end\n");
+
+	vcd.declared = b;
+	vcd_printf("#%llu\n$dumpvars\n", (unsigned long long)vcd.start);
+	for (b = 0; b < vcd.declared; b++)
+		for (s = 0; s < VCD_SIGNALS; s++)
+			vcd_value(b, s);
+	vcd_printf("$end\n");
+
+	vcd.last = vcd.start;
+	vcd.header = 1;
+}
+
+void
+vcd_open(const char *path, int precision, uint64_t now)
+{
+	vcd.f = fopen(path, "w");
+	if (vcd.f == NULL)
+		err(1, "+DE2_vcd: %s", path);
+
+	vcd.path = path;
+	vcd.precision = precision;
+	vcd.start = now;
+
+	vcd.buf[0] = malloc(VCD_BUF_LEN);
+	vcd.buf[1] = malloc(VCD_BUF_LEN);
+	if (vcd.buf[0] == NULL || vcd.buf[1] == NULL)
+		err(1, "+DE2_vcd: malloc");
+
+	vcd.lock = SDL_CreateMutex();
+	vcd.cond = SDL_CreateCond();
+	if (vcd.lock == NULL || vcd.cond == NULL)
+		err(1, "+DE2_vcd: %s", SDL_GetError());
+
+	vcd.thread = SDL_CreateThread(writer_main, "DE2 VCD", NULL);
+	if (vcd.thread == NULL)
+		err(1, "SDL_CreateThread: %s", SDL_GetError());
+}
+
+void
+vcd_board(int board, const uint32_t *switches, const uint32_t *buttons)
+{
+	if (vcd.header) {
+		if (!vcd.late_warned)
+			warnx("DE2: board %d was added after the VCD header was written, and is not recorded", board);
+		vcd.late_warned = 1;
+		return;
+	}
+
+	memcpy(vcd.val[board][VCD_SWITCHES], switches, VEC_WORDS(N_SW) * sizeof(*switches));
+	memcpy(vcd.val[board][VCD_BUTTONS], buttons, VEC_WORDS(N_BTN) * sizeof(*buttons));
+	vcd.known[board] = 1;
+}
+
+void
+vcd_change(int board, enum vcd_signal sig, uint64_t now, const uint32_t *bits)
+{
+	uint32_t *val = vcd.val[board][sig];
+	size_t n = VEC_WORDS(vcd_vars[sig].width) * sizeof(*bits);
+
+	if (!vcd.header) {
+		// Changes at the start time fold into the initial values.
+		if (now != vcd.start) {
+			vcd_header();
+		} else {
+			memcpy(val, bits, n);
+			return;
+		}
+	}
+	if (board >= vcd.declared || memcmp(val, bits, n) == 0)
+		return;
+
+	memcpy(val, bits, n);
+	vcd_timestamp(now);
+	vcd_value(board, sig);
+	vcd.changes++;
+}
+
+void
+vcd_close(uint64_t now)
+{
+	if (!vcd.header)
+		vcd_header();
+	vcd_timestamp(now);
+	vcd_flush();
+
+	SDL_LockMutex(vcd.lock);
+	vcd.closing = 1;
+	SDL_CondBroadcast(vcd.cond);
+	SDL_UnlockMutex(vcd.lock);
+
+	SDL_WaitThread(vcd.thread, NULL);
+
+	if (fclose(vcd.f) != 0)
+		err(1, "+DE2_vcd: %s", vcd.path);
+	free(vcd.buf[0]);
+	free(vcd.buf[1]);
+	SDL_DestroyCond(vcd.cond);
+	SDL_DestroyMutex(vcd.lock);
+
+	printf("DE2: wrote %lu board I/O changes to %s", vcd.changes, vcd.path);
+	if (vcd.waits)
+		printf(", waiting on the disk %lu times", vcd.waits);
+	printf("\n");
+	fflush(stdout);
+}
@@ -0,0 +1,39 @@
+#ifndef __DE2_VCD__
+#define __DE2_VCD__
+
+#include <stdint.h>
+
+#include "board.h"
+
+// A VCD of the board pins alone (+DE2_vcd=path): each board's leds,
+// switches & buttons, in a scope of its own (DE2.board0, DE2.board1, ...),
+// written from the board's own state updates rather than by $dumpvars.
+//
+// Everything is called from the simulator thread, with nondecreasing
+// times. Lines are formatted into a large buffer which a background thread
+// writes out while the other one fills; the simulator only ever waits for
+// it when the disk cannot keep up.
+enum vcd_signal {
+	VCD_LEDS,
+	VCD_SWITCHES,
+	VCD_BUTTONS,
+	VCD_SIGNALS
+};
+
+// The widest of them, in bits.
+#define VCD_MAX_WIDTH (N_LED > N_SW ? (N_LED > N_BTN ? N_LED : N_BTN) : (N_SW > N_BTN ? N_SW : N_BTN))
+
+// now is the start time, in units of 10^precision seconds.
+void vcd_open(const char *path, int precision, uint64_t now);
+
+// Declares a board, with its initial input positions; its LEDs start off.
+// Boards are declared in the header, which is written at the first change
+// after the start time, so boards added later than that are not recorded.
+void vcd_board(int board, const uint32_t *switches, const uint32_t *buttons);
+
+void vcd_change(int board, enum vcd_signal sig, uint64_t now, const uint32_t *bits);
+
+// Marks the end time, then writes out whatever is buffered.
+void vcd_close(uint64_t now);
+
+#endif
@@ -0,0 +1,52 @@
+#include <err.h>
+#include <stdlib.h>
+
+#include "vec_vpi.h"
+
+void
+vec_ones(const s_vpi_vecval *v, uint32_t *bits, int width)
+{
+	int i, n = VEC_WORDS(width);
+
+	for (i = 0; i < n; i++)
+		bits[i] = (uint32_t)(v[i].aval & ~v[i].bval);
+
+	if (width % 32)
+		bits[n - 1] &= (1u << (width % 32)) - 1;
+}
+
+void
+vec_get(vpiHandle h, uint32_t *bits, int width)
+{
+	s_vpi_value val;
+
+	val.format = vpiVectorVal;
+	vpi_get_value(h, &val);
+	vec_ones(val.value.vector, bits, width);
+}
+
+void
+vec_put(vpiHandle h, const uint32_t *bits, int width)
+{
+	// Only ever used from the simulator thread, so one buffer will do.
+	static s_vpi_vecval *buf;
+	static int buf_words;
+	s_vpi_value val;
+	int i, n = VEC_WORDS(width);
+
+	if (n > buf_words) {
+		buf = realloc(buf, n * sizeof(*buf));
+		if (buf == NULL)
+			err(1, "realloc");
+		buf_words = n;
+	}
+
+	for (i = 0; i < n; i++) {
+		buf[i].aval = (PLI_INT32)bits[i];
+		buf[i].bval = 0;
+	}
+
+	val.format = vpiVectorVal;
+	val.value.vector = buf;
+	vpi_put_value(h, &val, NULL, vpiNoDelay);
+}
@@ -0,0 +1,27 @@
+#ifndef __DE2_VEC__
+#define __DE2_VEC__
+
+#include <stdint.h>
+
+// Vectors of any width are kept as packed words of known-1 bits, LSB
+// first, bit n of the vector being bit n % 32 of word n / 32. X and Z read
+// as 0. Converting to and from VPI's aval/bval words thus works a word at
+// a time, never a bit at a time.
+#define VEC_WORDS(width) (((width) + 31) / 32)
+
+static inline int
+vec_bit(const uint32_t *bits, int n)
+{
+	return (bits[n / 32] >> (n % 32)) & 1;
+}
+
+static inline void
+vec_set_bit(uint32_t *bits, int n, int v)
+{
+	if (v)
+		bits[n / 32] |= 1u << (n % 32);
+	else
+		bits[n / 32] &= ~(1u << (n % 32));
+}
+
+#endif
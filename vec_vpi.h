@@ -0,0 +1,20 @@
+#ifndef __DE2_VEC_VPI__
+#define __DE2_VEC_VPI__
+
+#include <vpi_user.h>
+
+#include "vec.h"
+
+// Conversion between packed vectors (see vec.h) and VPI's aval/bval words,
+// for the VPI backend.
+
+// Extracts the known-1 bits of a width-bit aval/bval vector.
+void vec_ones(const s_vpi_vecval *v, uint32_t *bits, int width);
+
+// Reads a width-bit vector from h.
+void vec_get(vpiHandle h, uint32_t *bits, int width);
+
+// Writes bits to h as a fully known width-bit vector.
+void vec_put(vpiHandle h, const uint32_t *bits, int width);
+
+#endif